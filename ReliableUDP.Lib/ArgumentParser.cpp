@@ -1,10 +1,26 @@
 ﻿#include "ArgumentParser.h"
+#include <cstring>
 #include <string>
+#include <vector>
 
 Arguments ArgumentParser::Parse() const
 {
   Arguments args;
-  if (argc != 8)
+  // switches may appear anywhere; everything else is positional
+  std::vector<char*> argv;
+  for (int i = 0; i < this->argc; ++i)
+  {
+    if (strcmp(this->argv[i], "--rio") == 0)
+      args.RegisteredIo = true;
+    else if (strcmp(this->argv[i], "--ecn") == 0)
+      args.Ecn = true;
+    else if (strcmp(this->argv[i], "--v2") == 0)
+      args.V2 = true;
+    else
+      argv.push_back(this->argv[i]);
+  }
+  auto argc = argv.size();
+  if (argc != 8 && argc != 10)
   {
     args.Valid = false;
     return args;
@@ -18,6 +34,15 @@ Arguments ArgumentParser::Parse() const
     args.LossForward = std::stof(argv[5]);
     args.LossReturn = std::stof(argv[6]);
     args.BandwidthBottleneck = std::stof(argv[7]);
+    if (argc == 10)
+    {
+      args.Core = std::stoi(argv[8]);
+      auto spin = std::stoull(argv[9]);
+      // cores past the width of an affinity mask cannot be pinned to
+      if (args.Core >= static_cast<int>(sizeof(DWORD_PTR) * 8) || spin > MAXDWORD)
+        args.Valid = false;
+      args.SpinMicroseconds = static_cast<DWORD>(spin);
+    }
   } catch(...)
   {
     args.Valid = false;
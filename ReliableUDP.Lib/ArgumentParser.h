@@ -2,6 +2,8 @@
 // Martin Fracker
 // CSCE 463-500 Spring 2017
 #pragma once
+#define _WINSOCK_DEPRECATED_NO_WARNINGS
+#include <winsock2.h>
 #include <windows.h>
 
 struct Arguments
@@ -14,6 +16,11 @@ struct Arguments
   float LossForward = 0.;
   float LossReturn = 0.;
   float BandwidthBottleneck = 0.;
+  int Core = -1;
+  DWORD SpinMicroseconds = 0;
+  bool RegisteredIo = false;
+  bool Ecn = false;
+  bool V2 = false;
 };
 
 class ArgumentParser
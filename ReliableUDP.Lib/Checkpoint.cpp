@@ -0,0 +1,90 @@
+﻿// File: Checkpoint.cpp
+// Martin Fracker
+// CSCE 463-500 Spring 2017
+#include "Checkpoint.h"
+#include <cstdio>
+#include <cstddef>
+
+Checkpoint::~Checkpoint()
+{
+  Close();
+}
+
+bool Checkpoint::Open(const char* path, UINT64 transferId, std::vector<UINT64>& bitmap)
+{
+  Close();
+  File = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (File == INVALID_HANDLE_VALUE) {
+    printf("CreateFile() generated error %d\n", GetLastError());
+    return false;
+  }
+  TransferId = transferId;
+  Pending.reserve(CHECKPOINT_BATCH);
+  CheckpointRecord records[CHECKPOINT_BATCH];
+  DWORD bytes = 0;
+  LARGE_INTEGER valid;
+  valid.QuadPart = 0;
+  bool torn = false;
+  while (!torn && ReadFile(File, records, sizeof(records), &bytes, nullptr) && bytes > 0) {
+    for (DWORD i = 0; i < bytes / sizeof(CheckpointRecord); ++i) {
+      auto& record = records[i];
+      // only the last write can be torn, so nothing after a bad record is trusted
+      if (record.Crc != RecordCrc(record)) {
+        torn = true;
+        break;
+      }
+      valid.QuadPart += sizeof(CheckpointRecord);
+      if (record.TransferId != transferId)
+        continue;
+      auto word = static_cast<size_t>(record.Word);
+      if (word >= bitmap.size())
+        bitmap.resize(word + 1, 0);
+      bitmap[word] |= record.Bits;
+    }
+    torn = torn || bytes % sizeof(CheckpointRecord) != 0;
+  }
+  // new records go right after the last good one
+  if (!SetFilePointerEx(File, valid, nullptr, FILE_BEGIN) || !SetEndOfFile(File)) {
+    printf("failed to truncate the checkpoint with error %d\n", GetLastError());
+    Close();
+    return false;
+  }
+  return true;
+}
+
+void Checkpoint::Record(UINT64 word, UINT64 bits)
+{
+  if (!IsOpen())
+    return;
+  CheckpointRecord record;
+  record.TransferId = TransferId;
+  record.Word = word;
+  record.Bits = bits;
+  record.Crc = RecordCrc(record);
+  Pending.push_back(record);
+}
+
+void Checkpoint::Flush()
+{
+  if (!IsOpen() || Pending.empty())
+    return;
+  // Open left the file pointer at the end of the log and nothing else writes to it
+  DWORD written = 0;
+  if (!WriteFile(File, Pending.data(), static_cast<DWORD>(Pending.size() * sizeof(CheckpointRecord)), &written, nullptr))
+    printf("WriteFile() generated error %d\n", GetLastError());
+  Pending.clear();
+}
+
+void Checkpoint::Close()
+{
+  if (!IsOpen())
+    return;
+  Flush();
+  CloseHandle(File);
+  File = INVALID_HANDLE_VALUE;
+}
+
+DWORD Checkpoint::RecordCrc(const CheckpointRecord& record) const
+{
+  return Crc.CRC32((const UCHAR*)(&record), offsetof(CheckpointRecord, Crc));
+}
@@ -0,0 +1,51 @@
+﻿// File: Checkpoint.h
+// Martin Fracker
+// CSCE 463-500 Spring 2017
+#pragma once
+
+#define _WINSOCK_DEPRECATED_NO_WARNINGS
+#include <winsock2.h>
+#include <windows.h>
+#include <vector>
+#include "Checksum.h"
+
+#define CHECKPOINT_BATCH 64 // records read at a time while replaying
+
+#pragma pack(push, 1)
+struct CheckpointRecord {
+  UINT64 TransferId;
+  UINT64 Word; // index into the per-packet bitmap
+  UINT64 Bits; // value of that word when recorded
+  DWORD Crc; // CRC32 of the fields above; a torn final record fails it
+};
+#pragma pack(pop)
+
+// Append-only log of a transfer's per-packet bitmap, one 64-packet word per record.
+// Records are buffered until Flush(), so the owner can make the data they describe
+// durable first. The log itself is written without fsync: a machine crash may lose
+// its tail, and replay then just sees less progress.
+class Checkpoint
+{
+public:
+  Checkpoint() {}
+  ~Checkpoint();
+
+  // opens (creating if needed) the log and ORs every valid record of transferId into bitmap,
+  // growing it to fit. Anything after the last whole valid record is cut off, so a torn
+  // final record cannot misalign the records appended after it.
+  bool Open(const char* path, UINT64 transferId, std::vector<UINT64>& bitmap);
+  // buffers a record; nothing is written until Flush()
+  void Record(UINT64 word, UINT64 bits);
+  // hands buffered records to the OS
+  void Flush();
+  void Close();
+  bool IsOpen() const { return File != INVALID_HANDLE_VALUE; }
+
+private:
+  HANDLE File = INVALID_HANDLE_VALUE;
+  UINT64 TransferId = 0;
+  std::vector<CheckpointRecord> Pending;
+  Checksum Crc;
+
+  DWORD RecordCrc(const CheckpointRecord& record) const;
+};
@@ -2,6 +2,7 @@
 // Martin Fracker
 // CSCE 463-500 Spring 2017
 #include "Checksum.h"
+#include <cstring>
 
 Checksum::Checksum()
 {
@@ -11,14 +12,26 @@ Checksum::Checksum()
     for (int j = 0; j < 8; j++) {
       c = (c & 1) ? (0xEDB88320 ^ (c >> 1)) : (c >> 1);
     }
-    crc_table[i] = c;
+    crc_table[0][i] = c;
   }
+  for (DWORD i = 0; i < 256; i++)
+    for (int k = 1; k < 8; k++)
+      crc_table[k][i] = (crc_table[k - 1][i] >> 8) ^ crc_table[0][crc_table[k - 1][i] & 0xFF];
 }
 
-DWORD Checksum::CRC32(UCHAR* buf, size_t len)
+DWORD Checksum::CRC32(const UCHAR* buf, size_t len) const
 {
   DWORD c = 0xFFFFFFFF;
+  // eight bytes per step, read little endian like every Windows target
+  for (; len >= 8; buf += 8, len -= 8) {
+    DWORD lo, hi;
+    memcpy(&lo, buf, sizeof(lo));
+    memcpy(&hi, buf + 4, sizeof(hi));
+    lo ^= c;
+    c = crc_table[7][lo & 0xFF] ^ crc_table[6][(lo >> 8) & 0xFF] ^ crc_table[5][(lo >> 16) & 0xFF] ^ crc_table[4][lo >> 24]
+      ^ crc_table[3][hi & 0xFF] ^ crc_table[2][(hi >> 8) & 0xFF] ^ crc_table[1][(hi >> 16) & 0xFF] ^ crc_table[0][hi >> 24];
+  }
   for (size_t i = 0; i < len; i++)
-    c = crc_table[(c ^ buf[i]) & 0xFF] ^ (c >> 8);
+    c = crc_table[0][(c ^ buf[i]) & 0xFF] ^ (c >> 8);
   return c ^ 0xFFFFFFFF;
 }
@@ -2,7 +2,8 @@
 // Martin Fracker
 // CSCE 463-500 Spring 2017
 #pragma once
-#include <unordered_map>
+#define _WINSOCK_DEPRECATED_NO_WARNINGS
+#include <winsock2.h>
 #include <windows.h>
 
 class Checksum
@@ -10,8 +11,9 @@ class Checksum
 public:
   Checksum();
 
-  DWORD CRC32(UCHAR* buf, size_t len);
+  DWORD CRC32(const UCHAR* buf, size_t len) const;
   
 private:
-  std::unordered_map<DWORD, DWORD> crc_table;
+  // slicing-by-8: crc_table[k][b] is the CRC of byte b followed by k zero bytes
+  DWORD crc_table[8][256];
 };
@@ -0,0 +1,321 @@
+﻿// File: Delta.cpp
+// Martin Fracker
+// CSCE 463-500 Spring 2017
+#include "Delta.h"
+#include <cstring>
+#include <thread>
+
+static DWORD Tag(DWORD weak)
+{
+  return (weak ^ (weak >> 16)) & 0xFFFF;
+}
+
+static unsigned ThreadsFor(UINT64 bytes, unsigned threads)
+{
+  if (threads == 0)
+    threads = max(std::thread::hardware_concurrency(), 1u);
+  // small inputs are not worth the thread start-up
+  return static_cast<unsigned>(max(min(static_cast<UINT64>(threads), bytes / DELTA_MIN_SPLIT), 1ULL));
+}
+
+template <typename Work>
+static void InParallel(unsigned threads, Work work)
+{
+  std::vector<std::thread> pool;
+  for (unsigned worker = 1; worker < threads; ++worker)
+    pool.emplace_back(work, worker);
+  work(0);
+  for (auto& thread : pool)
+    thread.join();
+}
+
+void RollingChecksum::Reset(const UCHAR* block, DWORD length)
+{
+  // no dependency between iterations except the two sums, so this vectorizes
+  DWORD a = 0;
+  DWORD b = 0;
+  for (DWORD i = 0; i < length; ++i) {
+    a += block[i];
+    b += (length - i) * block[i];
+  }
+  A = a;
+  B = b;
+  Length = length;
+}
+
+void RollingChecksum::Roll(UCHAR out, UCHAR in)
+{
+  A += in - out;
+  B += A - Length * out;
+}
+
+void DeltaSignature::Build(const char* basis, UINT64 bytes, DWORD blockSize, unsigned threads)
+{
+  BlockSize = max(blockSize, 1);
+  BasisBytes = bytes;
+  Blocks.resize(static_cast<size_t>(bytes / BlockSize));
+  auto workers = ThreadsFor(bytes, threads);
+  InParallel(workers, [&](unsigned worker) {
+    Checksum crc;
+    RollingChecksum weak;
+    auto first = Blocks.size() * worker / workers;
+    auto last = Blocks.size() * (worker + 1) / workers;
+    for (auto i = first; i < last; ++i) {
+      auto block = (const UCHAR*)basis + static_cast<UINT64>(i) * BlockSize;
+      weak.Reset(block, BlockSize);
+      Blocks[i].Weak = weak.Value();
+      Blocks[i].Strong = crc.CRC32(block, BlockSize);
+    }
+  });
+  Index();
+}
+
+std::vector<char> DeltaSignature::Serialize() const
+{
+  SignatureHeader header;
+  header.Magic = DELTA_MAGIC;
+  header.BlockSize = BlockSize;
+  header.BasisBytes = BasisBytes;
+  header.Blocks = static_cast<DWORD>(Blocks.size());
+  std::vector<char> data(sizeof(header) + Blocks.size() * sizeof(BlockSignature));
+  memcpy(data.data(), &header, sizeof(header));
+  if (!Blocks.empty())
+    memcpy(data.data() + sizeof(header), Blocks.data(), Blocks.size() * sizeof(BlockSignature));
+  return data;
+}
+
+bool DeltaSignature::Deserialize(const char* data, size_t bytes)
+{
+  SignatureHeader header;
+  if (bytes < sizeof(header))
+    return false;
+  memcpy(&header, data, sizeof(header));
+  if (header.Magic != DELTA_MAGIC || header.BlockSize == 0 || (bytes - sizeof(header)) / sizeof(BlockSignature) < header.Blocks)
+    return false;
+  BlockSize = header.BlockSize;
+  BasisBytes = header.BasisBytes;
+  Blocks.resize(header.Blocks);
+  if (!Blocks.empty())
+    memcpy(Blocks.data(), data + sizeof(header), Blocks.size() * sizeof(BlockSignature));
+  Index();
+  return true;
+}
+
+void DeltaSignature::Index()
+{
+  // counting sort by tag; blocks sharing a tag stay in basis order, so the earliest wins
+  TagStart.assign(0x10000 + 1, 0);
+  for (auto& block : Blocks)
+    ++TagStart[Tag(block.Weak) + 1];
+  for (size_t tag = 1; tag < TagStart.size(); ++tag)
+    TagStart[tag] += TagStart[tag - 1];
+  auto next = TagStart;
+  Sorted.resize(Blocks.size());
+  for (DWORD i = 0; i < Blocks.size(); ++i)
+    Sorted[next[Tag(Blocks[i].Weak)]++] = i;
+}
+
+int DeltaSignature::Find(DWORD weak, const UCHAR* block, const Checksum& crc) const
+{
+  if (Blocks.empty())
+    return -1;
+  auto tag = Tag(weak);
+  bool hashed = false;
+  DWORD strong = 0;
+  for (auto i = TagStart[tag]; i < TagStart[tag + 1]; ++i) {
+    auto& candidate = Blocks[Sorted[i]];
+    if (candidate.Weak != weak)
+      continue;
+    if (!hashed) {
+      strong = crc.CRC32(block, BlockSize);
+      hashed = true;
+    }
+    if (candidate.Strong == strong)
+      return static_cast<int>(Sorted[i]);
+  }
+  return -1;
+}
+
+DeltaEncoder::DeltaEncoder(const DeltaSignature& signature, const char* data, UINT64 bytes, unsigned threads)
+  : Signature(signature), Data(data), Bytes(bytes), Threads(threads)
+{
+}
+
+void DeltaEncoder::Encode(const DeltaSignature& signature, const char* data, UINT64 bytes, std::vector<char>* delta, unsigned threads)
+{
+  DeltaEncoder encoder(signature, data, bytes, threads);
+  delta->clear();
+  while (!encoder.Done())
+    encoder.Next(max(bytes, 1ULL), delta);
+}
+
+void DeltaEncoder::Next(UINT64 segment, std::vector<char>* delta)
+{
+  if (Finished)
+    return;
+  auto blockSize = Signature.GetBlockSize();
+  if (!Started) {
+    DeltaHeader header;
+    header.Magic = DELTA_MAGIC;
+    header.BlockSize = blockSize;
+    header.TargetBytes = Bytes;
+    delta->insert(delta->end(), (char*)(&header), (char*)(&header) + sizeof(header));
+    Started = true;
+  }
+  // a match found in the last segment may reach into this one
+  auto first = max(Position, Covered);
+  auto last = max(min(Position + max(segment, 1ULL), Bytes), first);
+  auto workers = ThreadsFor(last - first, Threads);
+  std::vector<std::vector<Match>> matches(workers);
+  InParallel(workers, [&](unsigned worker) {
+    auto length = last - first;
+    Scan(Signature, (const UCHAR*)Data, Bytes, first + length * worker / workers, first + length * (worker + 1) / workers, &matches[worker]);
+  });
+  Position = last;
+
+  // a slice may open with matches that overlap the last match of the slice before it;
+  // the earlier one is kept. Runs of consecutive basis blocks become one op.
+  for (auto& slice : matches) {
+    for (auto& match : slice) {
+      if (match.Offset < Covered)
+        continue;
+      if (Pending && (match.Offset != Covered || match.Block != Copy.Block + Copy.Length))
+        FlushCopy(delta);
+      AppendLiteral(Data, Covered, match.Offset - Covered, delta);
+      if (!Pending) {
+        Copy.Kind = DELTA_COPY;
+        Copy.Block = match.Block;
+        Copy.Length = 0;
+        Pending = true;
+      }
+      ++Copy.Length;
+      Covered = match.Offset + blockSize;
+    }
+  }
+  // nothing in the segment past the last match starts a block, so it goes out as a
+  // literal now rather than waiting for the next segment
+  if (Covered < Position) {
+    FlushCopy(delta);
+    AppendLiteral(Data, Covered, Position - Covered, delta);
+    Covered = Position;
+  }
+  if (Position == Bytes) {
+    FlushCopy(delta);
+    Finished = true;
+  }
+}
+
+void DeltaEncoder::FlushCopy(std::vector<char>* delta)
+{
+  if (!Pending)
+    return;
+  delta->insert(delta->end(), (char*)(&Copy), (char*)(&Copy) + sizeof(Copy));
+  Pending = false;
+}
+
+void DeltaEncoder::Scan(const DeltaSignature& signature, const UCHAR* data, UINT64 bytes, UINT64 first, UINT64 last, std::vector<Match>* matches)
+{
+  Checksum crc;
+  RollingChecksum weak;
+  auto blockSize = signature.GetBlockSize();
+  auto position = first;
+  bool rolling = false;
+  // matches start inside [first, last) but may read past last
+  while (position < last && position + blockSize <= bytes) {
+    if (!rolling) {
+      weak.Reset(data + position, blockSize);
+      rolling = true;
+    }
+    auto block = signature.Find(weak.Value(), data + position, crc);
+    if (block >= 0) {
+      Match match;
+      match.Offset = position;
+      match.Block = static_cast<DWORD>(block);
+      matches->push_back(match);
+      position += blockSize;
+      rolling = false;
+      continue;
+    }
+    if (position + blockSize < bytes)
+      weak.Roll(data[position], data[position + blockSize]);
+    ++position;
+  }
+}
+
+void DeltaEncoder::AppendLiteral(const char* data, UINT64 offset, UINT64 length, std::vector<char>* delta)
+{
+  while (length > 0) {
+    DeltaOp op;
+    op.Kind = DELTA_LITERAL;
+    op.Block = 0;
+    op.Length = static_cast<DWORD>(min(length, static_cast<UINT64>(MAXDWORD)));
+    delta->insert(delta->end(), (char*)(&op), (char*)(&op) + sizeof(op));
+    delta->insert(delta->end(), data + offset, data + offset + op.Length);
+    offset += op.Length;
+    length -= op.Length;
+  }
+}
+
+bool DeltaDecoder::Apply(const char* basis, UINT64 basisBytes, const char* delta, size_t deltaBytes, std::vector<char>* target, unsigned threads)
+{
+  DeltaHeader header;
+  if (deltaBytes < sizeof(header))
+    return false;
+  memcpy(&header, delta, sizeof(header));
+  if (header.Magic != DELTA_MAGIC || header.BlockSize == 0)
+    return false;
+  // check every op and work out where it lands first, so the copies can then run in any order
+  struct Copy
+  {
+    const char* Source;
+    UINT64 Offset;
+    UINT64 Length;
+  };
+  std::vector<Copy> copies;
+  UINT64 offset = 0;
+  size_t position = sizeof(header);
+  while (position < deltaBytes) {
+    DeltaOp op;
+    if (deltaBytes - position < sizeof(op))
+      return false;
+    memcpy(&op, delta + position, sizeof(op));
+    position += sizeof(op);
+    Copy copy;
+    copy.Offset = offset;
+    if (op.Kind == DELTA_LITERAL) {
+      if (deltaBytes - position < op.Length)
+        return false;
+      copy.Source = delta + position;
+      copy.Length = op.Length;
+      position += op.Length;
+    } else if (op.Kind == DELTA_COPY) {
+      UINT64 start = static_cast<UINT64>(op.Block) * header.BlockSize;
+      copy.Length = static_cast<UINT64>(op.Length) * header.BlockSize;
+      if (start > basisBytes || copy.Length > basisBytes - start)
+        return false;
+      copy.Source = basis + start;
+    } else {
+      return false;
+    }
+    offset += copy.Length;
+    if (offset > header.TargetBytes)
+      return false;
+    copies.push_back(copy);
+  }
+  if (offset != header.TargetBytes)
+    return false;
+  target->resize(static_cast<size_t>(header.TargetBytes));
+  auto workers = ThreadsFor(header.TargetBytes, threads);
+  InParallel(workers, [&](unsigned worker) {
+    // each worker fills one contiguous share of the target, cutting ops at its edges
+    UINT64 first = header.TargetBytes * worker / workers;
+    UINT64 last = header.TargetBytes * (worker + 1) / workers;
+    for (auto& copy : copies) {
+      auto from = max(copy.Offset, first);
+      auto to = min(copy.Offset + copy.Length, last);
+      if (from < to)
+        memcpy(target->data() + from, copy.Source + (from - copy.Offset), static_cast<size_t>(to - from));
+    }
+  });
+  return true;
+}
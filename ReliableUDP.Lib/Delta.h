@@ -0,0 +1,124 @@
+﻿// File: Delta.h
+// Martin Fracker
+// CSCE 463-500 Spring 2017
+#pragma once
+
+#define _WINSOCK_DEPRECATED_NO_WARNINGS
+#include <winsock2.h>
+#include <windows.h>
+#include <vector>
+#include "Checksum.h"
+
+#define DELTA_MAGIC 0x544C4544 // "DELT"
+#define DELTA_BLOCK_SIZE 4096 // default bytes per signature block
+#define DELTA_LITERAL 0
+#define DELTA_COPY 1
+#define DELTA_MIN_SPLIT (1 << 20) // smallest share of work worth its own thread (in bytes)
+#define DELTA_SEGMENT (16 << 20) // data SendDelta encodes before sending what it has (in bytes)
+
+#pragma pack(push, 1)
+struct BlockSignature {
+  DWORD Weak; // rolling checksum, cheap to slide one byte at a time
+  DWORD Strong; // CRC32, confirms a weak match
+};
+struct SignatureHeader {
+  DWORD Magic;
+  DWORD BlockSize;
+  UINT64 BasisBytes;
+  DWORD Blocks; // BlockSignatures that follow, one per full block of the basis
+};
+struct DeltaHeader {
+  DWORD Magic;
+  DWORD BlockSize;
+  UINT64 TargetBytes; // size of the rebuilt data
+};
+struct DeltaOp {
+  BYTE Kind; // DELTA_LITERAL: Length bytes of data follow; DELTA_COPY: Length basis blocks from Block on
+  DWORD Block;
+  DWORD Length;
+};
+#pragma pack(pop)
+
+// rsync's weak checksum: a is the byte sum and b the sum of the running a values,
+// both modulo 2^16. Sliding the window by one byte is O(1).
+class RollingChecksum
+{
+public:
+  void Reset(const UCHAR* block, DWORD length);
+  void Roll(UCHAR out, UCHAR in);
+  DWORD Value() const { return (A & 0xFFFF) | (B << 16); }
+
+private:
+  DWORD A = 0;
+  DWORD B = 0;
+  DWORD Length = 0;
+};
+
+// Block signatures of the receiver's existing copy (the basis). They are built
+// there and travel to the sender as an ordinary transfer in the other direction.
+class DeltaSignature
+{
+public:
+  // threads == 0 uses every core
+  void Build(const char* basis, UINT64 bytes, DWORD blockSize = DELTA_BLOCK_SIZE, unsigned threads = 0);
+  std::vector<char> Serialize() const;
+  bool Deserialize(const char* data, size_t bytes);
+
+  DWORD GetBlockSize() const { return BlockSize; }
+  // index of the basis block that equals block, which has weak checksum weak, or -1
+  int Find(DWORD weak, const UCHAR* block, const Checksum& crc) const;
+
+private:
+  DWORD BlockSize = DELTA_BLOCK_SIZE;
+  UINT64 BasisBytes = 0;
+  std::vector<BlockSignature> Blocks;
+  // blocks ordered by the 16-bit tag of their weak checksum, and where each tag starts,
+  // so a position that matches nothing is rejected with two loads
+  std::vector<DWORD> Sorted;
+  std::vector<DWORD> TagStart;
+
+  void Index();
+};
+
+// Describes data as literals and references to blocks of the basis, one segment of
+// data at a time so the whole delta never has to be held in memory. Each thread scans
+// its own slice of a segment; matches are stitched together afterwards.
+class DeltaEncoder
+{
+public:
+  DeltaEncoder(const DeltaSignature& signature, const char* data, UINT64 bytes, unsigned threads = 0);
+  // appends the delta for the next `segment` bytes of data (the header first); the
+  // concatenation of everything appended until Done() is one delta for DeltaDecoder
+  void Next(UINT64 segment, std::vector<char>* delta);
+  bool Done() const { return Finished; }
+
+  static void Encode(const DeltaSignature& signature, const char* data, UINT64 bytes, std::vector<char>* delta, unsigned threads = 0);
+
+private:
+  struct Match
+  {
+    UINT64 Offset;
+    DWORD Block;
+  };
+  const DeltaSignature& Signature;
+  const char* Data;
+  UINT64 Bytes;
+  unsigned Threads;
+  UINT64 Position = 0; // data up to here has been scanned
+  UINT64 Covered = 0; // and up to here described by ops, some maybe still in Copy
+  DeltaOp Copy;
+  bool Pending = false; // Copy is still growing
+  bool Started = false;
+  bool Finished = false;
+
+  void FlushCopy(std::vector<char>* delta);
+  static void Scan(const DeltaSignature& signature, const UCHAR* data, UINT64 bytes, UINT64 first, UINT64 last, std::vector<Match>* matches);
+  static void AppendLiteral(const char* data, UINT64 offset, UINT64 length, std::vector<char>* delta);
+};
+
+class DeltaDecoder
+{
+public:
+  // rebuilds the sender's data from the basis and a delta; false if the delta is malformed
+  static bool Apply(const char* basis, UINT64 basisBytes, const char* delta, size_t deltaBytes, std::vector<char>* target, unsigned threads = 0);
+};
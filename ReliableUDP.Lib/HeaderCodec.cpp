@@ -0,0 +1,107 @@
+﻿// File: HeaderCodec.cpp
+// Martin Fracker
+// CSCE 463-500 Spring 2017
+#include "HeaderCodec.h"
+#include <cstring>
+
+DWORD HeaderCodec::SequenceBytes(UINT64 window)
+{
+  // the receiver expands around its cumulative ack, which stays within a window of every
+  // packet still being sent; the margin keeps long-delayed duplicates from aliasing
+  DWORD bytes = 1;
+  while (bytes < V2_MAX_SEQUENCE_BYTES && (1ULL << (8 * bytes - 1)) <= V2_SEQUENCE_MARGIN * (window + 1))
+    ++bytes;
+  return bytes;
+}
+
+size_t HeaderCodec::Encode(char* out, UINT64 sequence, DWORD sequenceBytes, bool stream, const char* extensions, size_t extensionsLength)
+{
+  BYTE flags = V2_MARKER | static_cast<BYTE>((sequenceBytes - 1) << V2_SEQUENCE_SHIFT);
+  if (stream)
+    flags |= V2_STREAM;
+  if (extensionsLength > 0)
+    flags |= V2_EXTENSIONS;
+  out[0] = flags;
+  for (DWORD i = 0; i < sequenceBytes; ++i)
+    out[1 + i] = static_cast<char>(sequence >> (8 * i));
+  size_t length = 1 + sequenceBytes;
+  if (extensionsLength > 0) {
+    memcpy(out + length, extensions, extensionsLength);
+    length += extensionsLength;
+    out[length++] = EXT_END;
+  }
+  return length;
+}
+
+bool HeaderCodec::Decode(const char* data, size_t length, UINT64 expected, UINT64* sequence, bool* stream, size_t* headerLength, const char** extensions, size_t* extensionsLength)
+{
+  if (length < 1)
+    return false;
+  BYTE flags = data[0];
+  if (!(flags & V2_MARKER) || (flags & V2_RESERVED))
+    return false;
+  DWORD bytes = ((flags & V2_SEQUENCE_MASK) >> V2_SEQUENCE_SHIFT) + 1;
+  size_t position = 1 + bytes;
+  if (length < position)
+    return false;
+  UINT64 truncated = 0;
+  for (DWORD i = 0; i < bytes; ++i)
+    truncated |= static_cast<UINT64>(static_cast<BYTE>(data[1 + i])) << (8 * i);
+  auto first = position;
+  if (flags & V2_EXTENSIONS) {
+    // walk the TLVs to find where the payload starts
+    while (true) {
+      if (position >= length)
+        return false;
+      BYTE type = data[position++];
+      if (type == EXT_END)
+        break;
+      if (position >= length)
+        return false;
+      BYTE size = data[position++];
+      if (length - position < size)
+        return false;
+      position += size;
+    }
+  }
+  *sequence = Expand(truncated, bytes, expected);
+  *stream = (flags & V2_STREAM) != 0;
+  *headerLength = position;
+  if (extensions != nullptr) {
+    *extensions = data + first;
+    *extensionsLength = position - first;
+  }
+  return true;
+}
+
+UINT64 HeaderCodec::Expand(UINT64 truncated, DWORD bytes, UINT64 expected)
+{
+  UINT64 range = 1ULL << (8 * bytes);
+  UINT64 half = range / 2;
+  UINT64 candidate = (expected & ~(range - 1)) | truncated;
+  // compare distances rather than sums, which overflow at the top of the sequence space
+  if (candidate <= expected && expected - candidate >= half && candidate <= MAXUINT64 - range)
+    return candidate + range;
+  if (candidate > expected && candidate - expected > half && candidate >= range)
+    return candidate - range;
+  return candidate;
+}
+
+size_t HeaderCodec::AppendExtension(char* out, BYTE type, const void* value, BYTE length)
+{
+  out[0] = type;
+  out[1] = length;
+  memcpy(out + 2, value, length);
+  return 2 + length;
+}
+
+bool HeaderCodec::NextExtension(const char** cursor, BYTE* type, const char** value, BYTE* length)
+{
+  *type = (*cursor)[0];
+  if (*type == EXT_END)
+    return false;
+  *length = (*cursor)[1];
+  *value = *cursor + 2;
+  *cursor += 2 + *length;
+  return true;
+}
@@ -0,0 +1,46 @@
+﻿// File: HeaderCodec.h
+// Martin Fracker
+// CSCE 463-500 Spring 2017
+#pragma once
+
+#define _WINSOCK_DEPRECATED_NO_WARNINGS
+#include <winsock2.h>
+#include <windows.h>
+
+// Header format v2, used for data packets once both ends agreed on it in the handshake:
+//   byte 0     flags (below)
+//   1-4 bytes  low bytes of the 64-bit sequence, little endian
+//   optional   extension TLVs (type, length, value), closed by EXT_END
+// Bit 0 of a v1 header is Flags.Compact, which v1 leaves clear, so the two never mix up.
+#define V2_MARKER 0x01
+#define V2_SEQUENCE_MASK 0x06 // sequence bytes - 1
+#define V2_SEQUENCE_SHIFT 1
+#define V2_EXTENSIONS 0x08 // extension TLVs follow the sequence
+#define V2_STREAM 0x10 // a StreamHeader starts the payload, as with Flags.Stream
+#define V2_RESERVED 0xE0 // must be zero
+#define V2_MAX_SEQUENCE_BYTES 4
+#define V2_MAX_FIXED_HEADER (1 + V2_MAX_SEQUENCE_BYTES)
+#define V2_SEQUENCE_MARGIN 16 // half the encoded range covers this many windows
+
+// extension types
+#define EXT_END 0
+#define EXT_TIMESTAMP 1 // sender clock when the packet left
+#define EXT_SACK 2 // ranges received past the cumulative ack
+#define EXT_STREAM 3 // stream id and stream sequence, for streams without an in-payload StreamHeader
+
+class HeaderCodec
+{
+public:
+  // fewest sequence bytes that still decode unambiguously with this many packets in flight
+  static DWORD SequenceBytes(UINT64 window);
+  // writes a v2 data header to out and returns its length; extensions are TLVs from AppendExtension
+  static size_t Encode(char* out, UINT64 sequence, DWORD sequenceBytes, bool stream, const char* extensions = nullptr, size_t extensionsLength = 0);
+  // parses a v2 data header, expanding its sequence around expected; false if malformed
+  static bool Decode(const char* data, size_t length, UINT64 expected, UINT64* sequence, bool* stream, size_t* headerLength, const char** extensions = nullptr, size_t* extensionsLength = nullptr);
+  // the 64-bit sequence closest to expected whose low bytes are truncated
+  static UINT64 Expand(UINT64 truncated, DWORD bytes, UINT64 expected);
+
+  static size_t AppendExtension(char* out, BYTE type, const void* value, BYTE length);
+  // walks extensions returned by Decode; false once the list ends
+  static bool NextExtension(const char** cursor, BYTE* type, const char** value, BYTE* length);
+};
@@ -0,0 +1,102 @@
+﻿// File: PacketPlacer.cpp
+// Martin Fracker
+// CSCE 463-500 Spring 2017
+#include "PacketPlacer.h"
+#include <intrin.h>
+#include <cstring>
+#include "SenderSocket.h"
+
+void PacketPlacer::Reset(char* buffer, UINT64 bytes, size_t slotSize)
+{
+  Buffer = buffer;
+  BufferSize = bytes;
+  SlotSize = max(slotSize, static_cast<size_t>(1));
+  Packets = (bytes + SlotSize - 1) / SlotSize;
+  Bits.assign(static_cast<size_t>((Packets + BITS_IN_WORD - 1) / BITS_IN_WORD), 0);
+  AckSequence = 0;
+  BytesPlaced = 0;
+}
+
+bool PacketPlacer::Place(UINT64 sequence, const char* payload, size_t length, UINT64 window)
+{
+  UINT64 offset = sequence * SlotSize;
+  // nothing legitimate lies a full window past the ack; that is a stale duplicate
+  // whose truncated sequence expanded to the wrong value
+  if (sequence >= Packets || sequence >= AckSequence + window || length > SlotSize || offset + length > BufferSize)
+    return false;
+  auto& word = Bits[static_cast<size_t>(sequence / BITS_IN_WORD)];
+  UINT64 bit = 1ULL << (sequence % BITS_IN_WORD);
+  if (word & bit)
+    return false;
+  // payloads that arrived in order are already in place
+  if (payload != Buffer + offset)
+    memcpy(Buffer + offset, payload, length);
+  word |= bit;
+  BytesPlaced = max(BytesPlaced, offset + length);
+  if (sequence == AckSequence)
+    AdvanceAck();
+  return true;
+}
+
+bool PacketPlacer::Arrived(UINT64 sequence) const
+{
+  return sequence < Packets && (Bits[static_cast<size_t>(sequence / BITS_IN_WORD)] >> (sequence % BITS_IN_WORD)) & 1;
+}
+
+void PacketPlacer::Restore()
+{
+  Bits.resize(static_cast<size_t>((Packets + BITS_IN_WORD - 1) / BITS_IN_WORD));
+  AckSequence = 0;
+  BytesPlaced = 0;
+  if (Bits.empty())
+    return;
+  AdvanceAck();
+  for (auto word = Bits.size(); word-- > 0; ) {
+    if (Bits[word] != 0) {
+      UINT64 last = word * BITS_IN_WORD + HighestSetBit(Bits[word]);
+      BytesPlaced = min((last + 1) * SlotSize, BufferSize);
+      break;
+    }
+  }
+}
+
+void PacketPlacer::AdvanceAck()
+{
+  auto word = static_cast<size_t>(AckSequence / BITS_IN_WORD);
+  if (word >= Bits.size())
+    return;
+  // everything below the current ack has arrived, so only look at the bits above it
+  UINT64 missing = ~Bits[word] & (~0ULL << (AckSequence % BITS_IN_WORD));
+  while (missing == 0 && ++word < Bits.size())
+    missing = ~Bits[word];
+  UINT64 next = (missing == 0) ? Packets : word * BITS_IN_WORD + LowestSetBit(missing);
+  AckSequence = min(next, Packets);
+}
+
+unsigned long PacketPlacer::LowestSetBit(UINT64 word)
+{
+  unsigned long bit;
+#ifdef _WIN64
+  _BitScanForward64(&bit, word);
+#else
+  if (!_BitScanForward(&bit, static_cast<unsigned long>(word))) {
+    _BitScanForward(&bit, static_cast<unsigned long>(word >> 32));
+    bit += 32;
+  }
+#endif
+  return bit;
+}
+
+unsigned long PacketPlacer::HighestSetBit(UINT64 word)
+{
+  unsigned long bit;
+#ifdef _WIN64
+  _BitScanReverse64(&bit, word);
+#else
+  if (_BitScanReverse(&bit, static_cast<unsigned long>(word >> 32)))
+    bit += 32;
+  else
+    _BitScanReverse(&bit, static_cast<unsigned long>(word));
+#endif
+  return bit;
+}
@@ -0,0 +1,51 @@
+﻿// File: PacketPlacer.h
+// Martin Fracker
+// CSCE 463-500 Spring 2017
+#pragma once
+
+#define _WINSOCK_DEPRECATED_NO_WARNINGS
+#include <winsock2.h>
+#include <windows.h>
+#include <vector>
+
+// The receiver's destination buffer, cut into one slot per packet. Every payload is
+// written directly to its own slot, so out-of-order packets are never queued or copied
+// twice, and arrival is tracked in a bitmap with one bit per slot.
+class PacketPlacer
+{
+public:
+  void Reset(char* buffer, UINT64 bytes, size_t slotSize);
+  // copies payload into slot `sequence` unless it is already there; false for duplicates,
+  // packets that do not fit the buffer and anything `window` or more past the ack
+  bool Place(UINT64 sequence, const char* payload, size_t length, UINT64 window);
+  bool Arrived(UINT64 sequence) const;
+  char* Slot(UINT64 sequence) const { return Buffer + sequence * SlotSize; }
+
+  // first packet that has not arrived
+  UINT64 GetAckSequence() const { return AckSequence; }
+  UINT64 GetPackets() const { return Packets; }
+  // end of the furthest payload placed
+  UINT64 GetBytesPlaced() const { return BytesPlaced; }
+  // bytes in front of the ack, i.e. the part of the buffer with no holes
+  UINT64 GetContiguousBytes() const { return min(AckSequence * SlotSize, BytesPlaced); }
+
+  // the bitmap, one 64-packet word per element; call Restore() after changing it
+  std::vector<UINT64>& Words() { return Bits; }
+  const std::vector<UINT64>& Words() const { return Bits; }
+  // recomputes the ack and bytes placed from the bitmap alone
+  void Restore();
+
+  static unsigned long LowestSetBit(UINT64 word);
+  static unsigned long HighestSetBit(UINT64 word);
+
+private:
+  char* Buffer = nullptr;
+  UINT64 BufferSize = 0;
+  size_t SlotSize = 1;
+  UINT64 Packets = 0;
+  std::vector<UINT64> Bits;
+  UINT64 AckSequence = 0;
+  UINT64 BytesPlaced = 0;
+
+  void AdvanceAck();
+};
@@ -0,0 +1,466 @@
+﻿// File: ReceiverSocket.cpp
+// Martin Fracker
+// CSCE 463-500 Spring 2017
+#include "ReceiverSocket.h"
+#include <windows.h>
+#include <cstdio>
+
+ReceiverSocket::ReceiverSocket()
+{
+  WSADATA wsaData;
+  WORD wVersionRequested = MAKEWORD(2, 2);
+  if (WSAStartup(wVersionRequested, &wsaData) != 0) {
+    printf("WSAStartup error %d\n", WSAGetLastError());
+    std::exit(EXIT_FAILURE);
+  }
+  Socket = socket(AF_INET, SOCK_DGRAM, 0);
+  if (Socket == INVALID_SOCKET) {
+    printf("socket() generated error %d\n", WSAGetLastError());
+    std::exit(EXIT_FAILURE);
+  }
+  int kernelBuffer = 100e6; //100 meg
+  if (setsockopt(Socket, SOL_SOCKET, SO_RCVBUF, (char*)&kernelBuffer, sizeof(int)) == SOCKET_ERROR) {
+    printf("setsockopt() generated error %d\n", WSAGetLastError());
+    std::exit(EXIT_FAILURE);
+  }
+  // reading the ECN bits takes WSARecvMsg and the TOS byte in its control data
+  GUID recvMsgId = WSAID_WSARECVMSG;
+  DWORD bytes = 0;
+  int enable = 1;
+  if (WSAIoctl(Socket, SIO_GET_EXTENSION_FUNCTION_POINTER, &recvMsgId, sizeof(recvMsgId), &RecvMsg, sizeof(RecvMsg), &bytes, nullptr, nullptr) == SOCKET_ERROR
+    || setsockopt(Socket, IPPROTO_IP, IP_RECVTOS, (char*)&enable, sizeof(enable)) == SOCKET_ERROR)
+    RecvMsg = nullptr;
+  LARGE_INTEGER frequency;
+  QueryPerformanceFrequency(&frequency);
+  TicksPerSecond = frequency.QuadPart;
+  memset(&Remote, 0, sizeof(Remote));
+}
+
+ReceiverSocket::~ReceiverSocket()
+{
+  CheckpointAll();
+  Unmap();
+  closesocket(Socket);
+  WSACleanup();
+}
+
+int ReceiverSocket::Bind(DWORD port)
+{
+  if (Bound)
+    return STATUS_OK;
+  struct sockaddr_in local;
+  memset(&local, 0, sizeof(local));
+  local.sin_family = AF_INET;
+  local.sin_port = htons(port);
+  local.sin_addr.s_addr = htonl(INADDR_ANY);
+  if (bind(Socket, (struct sockaddr*)(&local), sizeof(local)) == SOCKET_ERROR) {
+    printf("bind() failed with error %d\n", WSAGetLastError());
+    return FAILED_RECV;
+  }
+  Bound = true;
+  return STATUS_OK;
+}
+
+int ReceiverSocket::Open(DWORD port, char* buffer, UINT64 bytes, DWORD receiverWindow)
+{
+  if (Opened)
+    return ALREADY_CONNECTED;
+  auto status = Bind(port);
+  if (status != STATUS_OK)
+    return status;
+  Buffer = buffer;
+  BufferSize = bytes;
+  Placer.Reset(buffer, bytes, PAYLOAD_SIZE);
+  Window = max(receiverWindow, 1);
+  FinSequence = 0;
+  FinReceived = false;
+  NextSlot = 0;
+  PlacedSinceCheckpoint = 0;
+  LowestSinceCheckpoint = ~0ULL;
+  HeaderLength = sizeof(SenderDataHeader);
+  V2Active = false;
+  Streams.clear();
+  Log.Close();
+  TransferId = 0;
+  Opened = true;
+  return STATUS_OK;
+}
+
+int ReceiverSocket::OpenFile(DWORD port, const char* path, UINT64 bytes, DWORD receiverWindow)
+{
+  if (Opened)
+    return ALREADY_CONNECTED;
+  File = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, 0, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (File == INVALID_HANDLE_VALUE) {
+    printf("CreateFile() generated error %d\n", GetLastError());
+    return FAILED_MAP;
+  }
+  // mapping a larger size than the file grows the file to match
+  Mapping = CreateFileMappingA(File, nullptr, PAGE_READWRITE, static_cast<DWORD>(bytes >> 32), static_cast<DWORD>(bytes), nullptr);
+  if (Mapping == nullptr) {
+    printf("CreateFileMapping() generated error %d\n", GetLastError());
+    Unmap();
+    return FAILED_MAP;
+  }
+  auto view = static_cast<char*>(MapViewOfFile(Mapping, FILE_MAP_WRITE, 0, 0, 0));
+  if (view == nullptr) {
+    printf("MapViewOfFile() generated error %d\n", GetLastError());
+    Unmap();
+    return FAILED_MAP;
+  }
+  auto status = Open(port, view, bytes, receiverWindow);
+  if (status != STATUS_OK) {
+    UnmapViewOfFile(view);
+    Unmap();
+  }
+  return status;
+}
+
+int ReceiverSocket::ReceiveDatagram(SenderDataHeader* header, UINT64* sequence, char** payload, size_t* payloadLength, struct sockaddr_in* from, int* ecn)
+{
+  // bet that the datagram is the next new packet, with a header as long as the last one,
+  // and let the kernel scatter its payload straight into that packet's slot; anything that
+  // would not fit goes to staging, as does anything before the handshake, when the slot
+  // may hold data about to be resumed
+  UINT64 offset = NextSlot * PAYLOAD_SIZE;
+  bool speculate = Connected && offset + PAYLOAD_SIZE <= BufferSize && !Placer.Arrived(NextSlot);
+  char* slot = speculate ? Placer.Slot(NextSlot) : Staging;
+  char head[sizeof(SenderDataHeader)];
+  WSABUF buffers[2];
+  buffers[0].buf = head;
+  buffers[0].len = static_cast<ULONG>(HeaderLength);
+  buffers[1].buf = slot;
+  buffers[1].len = static_cast<ULONG>(speculate ? PAYLOAD_SIZE : sizeof(Staging) - HeaderLength);
+  DWORD bytes = 0;
+  int result;
+  header->Flags.Magic = 0;
+  *ecn = ECN_NOT_ECT;
+  if (RecvMsg != nullptr) {
+    char control[WSA_CMSG_SPACE(sizeof(INT))];
+    WSAMSG msg;
+    msg.name = (struct sockaddr*)from;
+    msg.namelen = sizeof(*from);
+    msg.lpBuffers = buffers;
+    msg.dwBufferCount = 2;
+    msg.Control.buf = control;
+    msg.Control.len = sizeof(control);
+    msg.dwFlags = 0;
+    result = RecvMsg(Socket, &msg, &bytes, nullptr, nullptr);
+    if (result != SOCKET_ERROR) {
+      for (auto cmsg = WSA_CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = WSA_CMSG_NXTHDR(&msg, cmsg))
+        if (cmsg->cmsg_level == IPPROTO_IP && (cmsg->cmsg_type == IP_TOS || cmsg->cmsg_type == IP_ECN))
+          *ecn = *(INT*)WSA_CMSG_DATA(cmsg) & ECN_CE;
+    }
+  } else {
+    DWORD flags = 0;
+    int fromSize = sizeof(*from);
+    result = WSARecvFrom(Socket, buffers, 2, &bytes, &flags, (struct sockaddr*)from, &fromSize, nullptr, nullptr);
+  }
+  if (result == SOCKET_ERROR) {
+    auto error = WSAGetLastError();
+    // oversized datagrams are not ours
+    if (error == WSAEMSGSIZE)
+      return STATUS_OK;
+    printf("failed recvfrom with %d\n", error);
+    return FAILED_RECV;
+  }
+  if (bytes == 0)
+    return STATUS_OK;
+  bool compact = (head[0] & V2_MARKER) != 0;
+  size_t expectedLength = compact ? 2 + ((head[0] & V2_SEQUENCE_MASK) >> V2_SEQUENCE_SHIFT) : sizeof(SenderDataHeader);
+  bool aligned = bytes >= HeaderLength && expectedLength == HeaderLength && !(compact && (head[0] & V2_EXTENSIONS));
+  const char* data = head;
+  size_t available = HeaderLength;
+  if (!aligned) {
+    // lost the bet on the header length; lay the datagram out contiguously in staging
+    size_t headBytes = min(static_cast<size_t>(bytes), HeaderLength);
+    memmove(Staging + headBytes, slot, bytes - headBytes);
+    memcpy(Staging, head, headBytes);
+    data = Staging;
+    available = bytes;
+  }
+  size_t headerLength;
+  if (compact) {
+    bool stream;
+    if (!V2Active || !HeaderCodec::Decode(data, available, Placer.GetAckSequence(), sequence, &stream, &headerLength))
+      return STATUS_OK;
+    // hand the flags on the way a v1 header carries them
+    *header = SenderDataHeader();
+    header->Flags.Stream = stream;
+    header->Sequence = static_cast<DWORD>(*sequence);
+  } else {
+    if (available < sizeof(SenderDataHeader))
+      return STATUS_OK;
+    memcpy(header, data, sizeof(SenderDataHeader));
+    headerLength = sizeof(SenderDataHeader);
+    *sequence = HeaderCodec::Expand(header->Sequence, sizeof(header->Sequence), Placer.GetAckSequence());
+  }
+  if (headerLength <= sizeof(head))
+    HeaderLength = headerLength;
+  *payload = aligned ? slot : Staging + headerLength;
+  *payloadLength = bytes - headerLength;
+  return STATUS_OK;
+}
+
+bool ReceiverSocket::PlacePayload(UINT64 sequence, const char* payload, size_t length)
+{
+  if (!Placer.Place(sequence, payload, length, Window))
+    return false;
+  auto word = sequence / BITS_IN_WORD;
+  if (Placer.Words()[static_cast<size_t>(word)] == ~0ULL)
+    Log.Record(word, ~0ULL);
+  NextSlot = max(NextSlot, sequence + 1);
+  LowestSinceCheckpoint = min(LowestSinceCheckpoint, sequence);
+  // partly filled words are logged once per window, so a crash loses at most that much
+  if (++PlacedSinceCheckpoint >= Window)
+    CheckpointAll();
+  return true;
+}
+
+void ReceiverSocket::DeliverStream(UINT64 sequence, size_t length)
+{
+  // the stream header was placed along with the payload, so data is handed out in place
+  StreamHeader streamHeader;
+  memcpy(&streamHeader, Placer.Slot(sequence), sizeof(StreamHeader));
+  auto& stream = Streams[streamHeader.StreamId];
+  PlacedPacket placed;
+  placed.Sequence = sequence;
+  placed.Length = static_cast<DWORD>(length);
+  if (streamHeader.StreamSequence != stream.NextSequence) {
+    stream.Pending[streamHeader.StreamSequence] = placed;
+    return;
+  }
+  while (true) {
+    if (Handler)
+      Handler(streamHeader.StreamId, Placer.Slot(placed.Sequence) + sizeof(StreamHeader), placed.Length - sizeof(StreamHeader));
+    auto next = stream.Pending.find(++stream.NextSequence);
+    if (next == stream.Pending.end())
+      break;
+    placed = next->second;
+    stream.Pending.erase(next);
+  }
+}
+
+bool ReceiverSocket::ApplyDelta(const char* basis, UINT64 basisBytes, std::vector<char>* target) const
+{
+  if (Buffer == nullptr)
+    return false;
+  return DeltaDecoder::Apply(basis, basisBytes, Buffer, static_cast<size_t>(Placer.GetContiguousBytes()), target);
+}
+
+void ReceiverSocket::Resume(UINT64 transferId)
+{
+  // a repeated SYN must not replay the log over what this connection received
+  if (transferId == TransferId || CheckpointPath.empty())
+    return;
+  if (!Log.Open(CheckpointPath.c_str(), transferId, Placer.Words()))
+    return;
+  Placer.Restore();
+  TransferId = transferId;
+  NextSlot = Placer.GetAckSequence();
+}
+
+void ReceiverSocket::CheckpointAll()
+{
+  PlacedSinceCheckpoint = 0;
+  if (!Log.IsOpen())
+    return;
+  // full words were logged when they filled up; the partly filled ones all lie
+  // between the ack and the furthest packet placed
+  auto& words = Placer.Words();
+  auto end = min(static_cast<size_t>((NextSlot + BITS_IN_WORD - 1) / BITS_IN_WORD), words.size());
+  for (auto word = static_cast<size_t>(Placer.GetAckSequence() / BITS_IN_WORD); word < end; ++word)
+    if (words[word] != 0 && words[word] != ~0ULL)
+      Log.Record(word, words[word]);
+  // a record must never reach the disk ahead of the packets it vouches for
+  if (Mapping != nullptr && LowestSinceCheckpoint < NextSlot) {
+    auto first = LowestSinceCheckpoint * PAYLOAD_SIZE;
+    auto last = min(NextSlot * PAYLOAD_SIZE, BufferSize);
+    if (!FlushViewOfFile(Buffer + first, static_cast<size_t>(last - first)) || !FlushFileBuffers(File)) {
+      // the records stay buffered and go out with the next successful flush
+      printf("failed to flush the destination with error %d\n", GetLastError());
+      return;
+    }
+  }
+  LowestSinceCheckpoint = ~0ULL;
+  Log.Flush();
+}
+
+bool ReceiverSocket::QueueMarks()
+{
+  if (MarkThreshold == 0 || Link.Speed <= 0)
+    return false;
+  // drain the emulated queue at the bottleneck speed since the last arrival, then add this packet
+  LARGE_INTEGER now;
+  QueryPerformanceCounter(&now);
+  if (LastArrival != 0) {
+    auto elapsed = static_cast<double>(now.QuadPart - LastArrival) / TicksPerSecond;
+    QueueDepth = max(QueueDepth - elapsed * Link.Speed / (MAX_PKT_SIZE * BITS_IN_BYTE), 0.0);
+  }
+  LastArrival = now.QuadPart;
+  QueueDepth += 1;
+  return QueueDepth > MarkThreshold;
+}
+
+DWORD ReceiverSocket::AdvertisedWindow() const
+{
+  // never offer more than the destination can hold past the cumulative ack,
+  // but keep one slot open so the sender can always get its FIN through
+  UINT64 freeSlots = Placer.GetPackets() - Placer.GetAckSequence();
+  return static_cast<DWORD>(max(min(static_cast<UINT64>(Window), freeSlots), 1ULL));
+}
+
+int ReceiverSocket::SendAck(bool syn, bool fin, UINT64 ackSequence)
+{
+  ReceiverResumeHeader resume;
+  ReceiverEcnHeader& reply = resume.ReceiverEcnHeader;
+  ReceiverHeader& rh = reply.ReceiverHeader;
+  rh.Flags.Syn = syn;
+  rh.Flags.Fin = fin;
+  rh.Flags.Ack = 1;
+  rh.Flags.Ecn = EcnActive;
+  rh.ReceiverWindow = AdvertisedWindow();
+  rh.Flags.V2 = syn && V2Active;
+  rh.AckSequence = static_cast<DWORD>(ackSequence);
+  reply.CeCount = CeCount;
+  auto length = EcnActive ? sizeof(ReceiverEcnHeader) : sizeof(ReceiverHeader);
+  if (syn && TransferId != 0) {
+    // tell the sender what earlier connections delivered, from the first missing packet on
+    rh.Flags.Resume = 1;
+    resume.TransferId = TransferId;
+    auto& words = Placer.Words();
+    resume.ResumeSequence = Placer.GetAckSequence();
+    auto first = static_cast<size_t>(resume.ResumeSequence / BITS_IN_WORD);
+    resume.BitmapWords = static_cast<DWORD>(min(words.size() - min(first, words.size()), RESUME_BITMAP_WORDS));
+    memcpy(resume.Bitmap, words.data() + first, resume.BitmapWords * sizeof(UINT64));
+    length = sizeof(ReceiverResumeHeader) - (RESUME_BITMAP_WORDS - resume.BitmapWords) * sizeof(UINT64);
+  }
+  if (sendto(Socket, (char*)(&resume), length, 0, (struct sockaddr*)(&Remote), sizeof(Remote)) == SOCKET_ERROR) {
+    printf("failed sendto with error %d\n", WSAGetLastError());
+    return FAILED_SEND;
+  }
+  return STATUS_OK;
+}
+
+bool ReceiverSocket::IsRemote(const struct sockaddr_in& addr) const
+{
+  return addr.sin_addr.s_addr == Remote.sin_addr.s_addr && addr.sin_port == Remote.sin_port;
+}
+
+int ReceiverSocket::Receive(UINT64* bytesReceived)
+{
+  if (!Opened)
+    return NOT_CONNECTED;
+  SenderDataHeader header;
+  UINT64 sequence;
+  char* payload = nullptr;
+  size_t payloadLength = 0;
+  struct sockaddr_in from;
+  int ecn;
+  while (true) {
+    auto status = ReceiveDatagram(&header, &sequence, &payload, &payloadLength, &from, &ecn);
+    if (status != STATUS_OK) {
+      CheckpointAll();
+      return status;
+    }
+    if (header.Flags.Magic != MAGIC_PROTOCOL)
+      continue;
+    if (header.Flags.Syn) {
+      // a repeated SYN means our SYN-ACK was lost; nobody else may take over the transfer
+      if (Connected && !IsRemote(from))
+        continue;
+      if (!Connected)
+        FinReceived = false;
+      Remote = from;
+      Connected = true;
+      if (payloadLength >= sizeof(LinkProperties))
+        memcpy(&Link, payload, sizeof(LinkProperties));
+      EcnActive = header.Flags.Ecn && (RecvMsg != nullptr || MarkThreshold > 0);
+      V2Active = header.Flags.V2;
+      CeCount = 0;
+      QueueDepth = 0;
+      LastArrival = 0;
+      if (header.Flags.Resume && payloadLength >= sizeof(LinkProperties) + sizeof(ResumeRequest)) {
+        ResumeRequest request;
+        memcpy(&request, payload + sizeof(LinkProperties), sizeof(ResumeRequest));
+        Resume(request.TransferId);
+      }
+      if (SendAck(true, false, 0) != STATUS_OK)
+        return FAILED_SEND;
+      continue;
+    }
+    if (!Connected || !IsRemote(from))
+      continue;
+    if (header.Flags.Fin) {
+      // the FIN can overtake retransmissions still in flight; until they land keep
+      // acking cumulatively so the sender repairs the holes
+      FinSequence = sequence;
+      FinReceived = true;
+    }
+    else {
+      auto queueMarked = QueueMarks();
+      if (EcnActive && (ecn == ECN_CE || queueMarked))
+        ++CeCount;
+      if (PlacePayload(sequence, payload, payloadLength) && header.Flags.Stream && payloadLength >= sizeof(StreamHeader))
+        DeliverStream(sequence, payloadLength);
+    }
+    if (FinReceived && Placer.GetAckSequence() == FinSequence) {
+      CheckpointAll();
+      if (SendAck(false, true, FinSequence) != STATUS_OK)
+        return FAILED_SEND;
+      *bytesReceived = Placer.GetContiguousBytes();
+      return STATUS_OK;
+    }
+    if (SendAck(false, false, Placer.GetAckSequence()) != STATUS_OK)
+      return FAILED_SEND;
+  }
+}
+
+int ReceiverSocket::Close()
+{
+  if (!Opened)
+    return NOT_CONNECTED;
+  // our FIN-ACK may be lost, so keep answering retransmitted FINs for a while
+  auto deadline = timeGetTime() + CLOSE_LINGER * 1000;
+  SenderDataHeader header;
+  UINT64 sequence;
+  char* payload = nullptr;
+  size_t payloadLength = 0;
+  struct sockaddr_in from;
+  int ecn;
+  while (Connected && static_cast<int>(deadline - timeGetTime()) > 0) {
+    auto remainder = deadline - timeGetTime();
+    fd_set readers;
+    FD_ZERO(&readers);
+    FD_SET(Socket, &readers);
+    struct timeval timeout;
+    timeout.tv_sec = remainder / 1000;
+    timeout.tv_usec = (remainder % 1000) * 1000;
+    if (select(Socket, &readers, nullptr, nullptr, &timeout) <= 0)
+      break;
+    if (ReceiveDatagram(&header, &sequence, &payload, &payloadLength, &from, &ecn) != STATUS_OK)
+      break;
+    if (header.Flags.Magic == MAGIC_PROTOCOL && header.Flags.Fin && IsRemote(from) && Placer.GetAckSequence() == sequence)
+      SendAck(false, true, sequence);
+  }
+  // a transfer abandoned before its FIN still keeps what arrived
+  CheckpointAll();
+  Log.Close();
+  Unmap();
+  Buffer = nullptr;
+  Opened = false;
+  Connected = false;
+  return STATUS_OK;
+}
+
+void ReceiverSocket::Unmap()
+{
+  if (Mapping != nullptr && Buffer != nullptr)
+    UnmapViewOfFile(Buffer);
+  if (Mapping != nullptr)
+    CloseHandle(Mapping);
+  if (File != INVALID_HANDLE_VALUE)
+    CloseHandle(File);
+  Mapping = nullptr;
+  File = INVALID_HANDLE_VALUE;
+}
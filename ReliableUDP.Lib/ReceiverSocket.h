@@ -0,0 +1,116 @@
+﻿// File: ReceiverSocket.h
+// Martin Fracker
+// CSCE 463-500 Spring 2017
+#pragma once
+
+#define _WINSOCK_DEPRECATED_NO_WARNINGS
+#include <winsock2.h> // must precede windows.h, which would otherwise pull in winsock 1
+#include <mswsock.h>
+#include <windows.h>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "SenderSocket.h"
+#include "Checkpoint.h"
+#include "PacketPlacer.h"
+#include "Delta.h"
+
+#define PAYLOAD_SIZE (MAX_PKT_SIZE - sizeof(SenderDataHeader)) // data bytes carried by each full packet
+#define CLOSE_LINGER 2 // seconds to keep answering retransmitted FINs after the transfer
+
+// called with each newly contiguous run of a stream; data points into the destination
+typedef std::function<void(WORD streamId, const char* data, size_t length)> StreamHandler;
+
+// Receiving end of the protocol. Every payload is written directly at offset
+// Sequence * PAYLOAD_SIZE of the destination by a PacketPlacer.
+class ReceiverSocket
+{
+public:
+  ReceiverSocket();
+  ~ReceiverSocket();
+
+  // destination is a caller-owned buffer that must outlive the transfer
+  int Open(DWORD port, char* buffer, UINT64 bytes, DWORD receiverWindow);
+  // destination is a file of the given size, mapped into memory
+  int OpenFile(DWORD port, const char* path, UINT64 bytes, DWORD receiverWindow);
+  // runs the handshake and places data until the sender's FIN arrives
+  int Receive(UINT64* bytesReceived);
+  int Close();
+
+  UINT64 GetAckSequence() const { return Placer.GetAckSequence(); }
+  // after receiving a transfer sent with SenderSocket::SendDelta(), rebuilds the sender's
+  // data from basis (the copy the signature was built from) and the delta in the destination.
+  // Call it before Close(), which releases the destination
+  bool ApplyDelta(const char* basis, UINT64 basisBytes, std::vector<char>* target) const;
+  // stream packets are handed over as soon as their own stream is contiguous,
+  // whatever holes the other streams have
+  void SetStreamHandler(StreamHandler handler) { Handler = handler; }
+  // emulate the bottleneck described by the sender's LinkProperties and CE-mark
+  // packets that find more than `packets` already queued there; 0 turns it off
+  void SetEcnMarkThreshold(DWORD packets) { MarkThreshold = packets; }
+  // log which packets have arrived so a sender that reconnects with the same transfer id
+  // only sends the rest. Resumed packets must still be in the destination, so pair this
+  // with OpenFile() on the same file. Full 64-packet words are logged as they complete
+  // and partly filled ones once per window, so a crash costs at most about a window.
+  // The mapped data is flushed to disk before the records that cover it are written.
+  void SetCheckpoint(const char* path) { CheckpointPath = path; }
+
+private:
+  SOCKET Socket;
+  struct sockaddr_in Remote;
+  bool Bound = false;
+  bool Opened = false;
+  bool Connected = false;
+  char* Buffer = nullptr;
+  UINT64 BufferSize = 0;
+  HANDLE File = INVALID_HANDLE_VALUE;
+  HANDLE Mapping = nullptr;
+  DWORD Window = 1;
+  PacketPlacer Placer;
+  UINT64 FinSequence = 0;
+  bool FinReceived = false; // FinSequence is valid; the FIN is only acked once everything before it arrived
+  UINT64 NextSlot = 0; // one past the highest sequence seen; payloads are received straight into its slot
+  size_t HeaderLength = sizeof(SenderDataHeader); // header length of the last datagram, assumed for the next
+  bool V2Active = false;
+  char Staging[MAX_PKT_SIZE];
+  struct PlacedPacket
+  {
+    UINT64 Sequence;
+    DWORD Length;
+  };
+  struct StreamState
+  {
+    DWORD NextSequence = 0;
+    std::unordered_map<DWORD, PlacedPacket> Pending; // by stream sequence
+  };
+  std::unordered_map<WORD, StreamState> Streams;
+  StreamHandler Handler;
+  LPFN_WSARECVMSG RecvMsg = nullptr; // null when the TOS byte cannot be read
+  bool EcnActive = false;
+  DWORD CeCount = 0;
+  DWORD MarkThreshold = 0;
+  LinkProperties Link;
+  double QueueDepth = 0; // packets in the emulated router queue
+  INT64 LastArrival = 0;
+  INT64 TicksPerSecond = 1;
+  std::string CheckpointPath;
+  Checkpoint Log;
+  UINT64 TransferId = 0; // of the transfer being logged, 0 if none
+  DWORD PlacedSinceCheckpoint = 0;
+  UINT64 LowestSinceCheckpoint = ~0ULL; // lowest packet placed since then; the view is flushed from there
+
+  int Bind(DWORD port);
+  // header holds the flags of either format; sequence is the full 64-bit sequence
+  int ReceiveDatagram(SenderDataHeader* header, UINT64* sequence, char** payload, size_t* payloadLength, struct sockaddr_in* from, int* ecn);
+  bool QueueMarks();
+  bool PlacePayload(UINT64 sequence, const char* payload, size_t length);
+  void DeliverStream(UINT64 sequence, size_t length);
+  void Resume(UINT64 transferId);
+  // logs every partly filled word and flushes the log
+  void CheckpointAll();
+  DWORD AdvertisedWindow() const;
+  int SendAck(bool syn, bool fin, UINT64 ackSequence);
+  bool IsRemote(const struct sockaddr_in& addr) const;
+  void Unmap();
+};
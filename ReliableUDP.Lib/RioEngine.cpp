@@ -0,0 +1,254 @@
+﻿// File: RioEngine.cpp
+// Martin Fracker
+// CSCE 463-500 Spring 2017
+#include "RioEngine.h"
+#include <cstdio>
+#include "SenderSocket.h"
+
+RioEngine::RioEngine()
+{
+  memset(&Rio, 0, sizeof(Rio));
+  memset(&Remote, 0, sizeof(Remote));
+  LARGE_INTEGER frequency;
+  QueryPerformanceFrequency(&frequency);
+  TicksPerSecond = frequency.QuadPart;
+}
+
+RioEngine::~RioEngine()
+{
+  Shutdown();
+}
+
+void RioEngine::Shutdown()
+{
+  std::lock_guard<std::mutex> lock(QueueMutex);
+  if (RingId != RIO_INVALID_BUFFERID) {
+    DrainSends();
+    Rio.RIODeregisterBuffer(RingId);
+    RingId = RIO_INVALID_BUFFERID;
+  }
+  if (SendQueue != RIO_INVALID_CQ)
+    Rio.RIOCloseCompletionQueue(SendQueue);
+  SendQueue = RIO_INVALID_CQ;
+  if (ReceiveQueue != RIO_INVALID_CQ)
+    Rio.RIOCloseCompletionQueue(ReceiveQueue);
+  ReceiveQueue = RIO_INVALID_CQ;
+  if (ReceiveId != RIO_INVALID_BUFFERID)
+    Rio.RIODeregisterBuffer(ReceiveId);
+  ReceiveId = RIO_INVALID_BUFFERID;
+  if (RemoteId != RIO_INVALID_BUFFERID)
+    Rio.RIODeregisterBuffer(RemoteId);
+  RemoteId = RIO_INVALID_BUFFERID;
+  if (ReceiveEvent != nullptr)
+    CloseHandle(ReceiveEvent);
+  ReceiveEvent = nullptr;
+}
+
+bool RioEngine::Initialize(SOCKET socket)
+{
+  Socket = socket;
+  GUID functionTableId = WSAID_MULTIPLE_RIO;
+  DWORD bytes = 0;
+  if (WSAIoctl(Socket, SIO_GET_MULTIPLE_EXTENSION_FUNCTION_POINTER, &functionTableId, sizeof(functionTableId), &Rio, sizeof(Rio), &bytes, nullptr, nullptr) == SOCKET_ERROR)
+    return false;
+  ReceiveEvent = CreateEventA(nullptr, FALSE, FALSE, nullptr);
+  if (ReceiveEvent == nullptr)
+    return false;
+  ReceiveBuffer.resize(RIO_RECEIVE_SLOTS * MAX_PKT_SIZE);
+  ReceiveId = Rio.RIORegisterBuffer(ReceiveBuffer.data(), static_cast<DWORD>(ReceiveBuffer.size()));
+  RemoteId = Rio.RIORegisterBuffer((char*)(&Remote), sizeof(Remote));
+  return ReceiveId != RIO_INVALID_BUFFERID && RemoteId != RIO_INVALID_BUFFERID;
+}
+
+bool RioEngine::RegisterRing(char* ring, size_t slotSize, size_t slots)
+{
+  std::lock_guard<std::mutex> lock(QueueMutex);
+  // the ring of an earlier connection goes once the kernel is done sending from it
+  if (RingId != RIO_INVALID_BUFFERID) {
+    DrainSends();
+    Rio.RIODeregisterBuffer(RingId);
+    RingId = RIO_INVALID_BUFFERID;
+  }
+  Ring = ring;
+  SlotSize = max(slotSize, static_cast<size_t>(1));
+  Sending.assign(slots, 0);
+  RingId = Rio.RIORegisterBuffer(ring, static_cast<DWORD>(slotSize * slots));
+  if (RingId == RIO_INVALID_BUFFERID) {
+    printf("RIORegisterBuffer() generated error %d\n", WSAGetLastError());
+    return false;
+  }
+  // every slot may be in flight at once (a full window plus a retransmission)
+  auto sendDepth = static_cast<ULONG>(slots + 1);
+  if (Requests != RIO_INVALID_RQ) {
+    // a socket gets one request queue for life, so the queues are resized instead
+    if (!Rio.RIOResizeCompletionQueue(SendQueue, sendDepth) || !Rio.RIOResizeRequestQueue(Requests, RIO_RECEIVE_SLOTS, sendDepth)) {
+      printf("failed to resize the RIO queues with error %d\n", WSAGetLastError());
+      return false;
+    }
+    return true;
+  }
+  SendQueue = Rio.RIOCreateCompletionQueue(sendDepth, nullptr);
+  RIO_NOTIFICATION_COMPLETION notification;
+  notification.Type = RIO_EVENT_COMPLETION;
+  notification.Event.EventHandle = ReceiveEvent;
+  notification.Event.NotifyReset = TRUE;
+  ReceiveQueue = Rio.RIOCreateCompletionQueue(RIO_RECEIVE_SLOTS, &notification);
+  if (SendQueue == RIO_INVALID_CQ || ReceiveQueue == RIO_INVALID_CQ) {
+    printf("RIOCreateCompletionQueue() generated error %d\n", WSAGetLastError());
+    return false;
+  }
+  Requests = Rio.RIOCreateRequestQueue(Socket, RIO_RECEIVE_SLOTS, 1, sendDepth, 1, ReceiveQueue, SendQueue, nullptr);
+  if (Requests == RIO_INVALID_RQ) {
+    printf("RIOCreateRequestQueue() generated error %d\n", WSAGetLastError());
+    return false;
+  }
+  for (ULONG slot = 0; slot < RIO_RECEIVE_SLOTS; ++slot)
+    if (!PostReceive(slot))
+      return false;
+  return true;
+}
+
+void RioEngine::SetRemote(const struct sockaddr_in& remote)
+{
+  memset(&Remote, 0, sizeof(Remote));
+  Remote.Ipv4 = remote;
+}
+
+bool RioEngine::Send(const char* slot, size_t length)
+{
+  auto index = static_cast<size_t>(slot - Ring) / SlotSize;
+  RIO_BUF data;
+  data.BufferId = RingId;
+  data.Offset = static_cast<ULONG>(slot - Ring);
+  data.Length = static_cast<ULONG>(length);
+  RIO_BUF remote;
+  remote.BufferId = RemoteId;
+  remote.Offset = 0;
+  remote.Length = sizeof(Remote);
+  std::lock_guard<std::mutex> lock(QueueMutex);
+  ReapSends();
+  // the completion names the slot it came from
+  auto context = reinterpret_cast<PVOID>(static_cast<ULONG_PTR>(index));
+  while (!Rio.RIOSendEx(Requests, &data, 1, nullptr, &remote, nullptr, nullptr, 0, context)) {
+    auto error = WSAGetLastError();
+    if (error != WSAENOBUFS) {
+      printf("failed RIOSendEx with error %d\n", error);
+      return false;
+    }
+    // request queue is full, wait for the kernel to finish earlier sends
+    YieldProcessor();
+    ReapSends();
+  }
+  ++Sending[index];
+  ++Outstanding;
+  return true;
+}
+
+void RioEngine::Reclaim(const char* slot)
+{
+  auto index = static_cast<size_t>(slot - Ring) / SlotSize;
+  std::lock_guard<std::mutex> lock(QueueMutex);
+  while (Sending[index] > 0) {
+    ReapSends();
+    if (Sending[index] > 0)
+      YieldProcessor();
+  }
+}
+
+void RioEngine::ReapSends()
+{
+  RIORESULT results[RIO_RESULTS];
+  auto count = Rio.RIODequeueCompletion(SendQueue, results, RIO_RESULTS);
+  if (count == RIO_CORRUPT_CQ)
+    return;
+  for (ULONG i = 0; i < count; ++i) {
+    auto index = static_cast<size_t>(results[i].RequestContext);
+    if (index < Sending.size() && Sending[index] > 0) {
+      --Sending[index];
+      --Outstanding;
+    }
+  }
+}
+
+void RioEngine::DrainSends()
+{
+  while (Outstanding > 0) {
+    YieldProcessor();
+    ReapSends();
+  }
+}
+
+bool RioEngine::PostReceive(ULONG slot)
+{
+  RIO_BUF buffer;
+  buffer.BufferId = ReceiveId;
+  buffer.Offset = slot * MAX_PKT_SIZE;
+  buffer.Length = MAX_PKT_SIZE;
+  if (!Rio.RIOReceive(Requests, &buffer, 1, 0, reinterpret_cast<PVOID>(static_cast<ULONG_PTR>(slot)))) {
+    printf("failed RIOReceive with error %d\n", WSAGetLastError());
+    return false;
+  }
+  return true;
+}
+
+int RioEngine::TryReceive(char* packet, size_t packetLength)
+{
+  if (NextResult == ResultCount) {
+    auto count = Rio.RIODequeueCompletion(ReceiveQueue, Results, RIO_RESULTS);
+    if (count == RIO_CORRUPT_CQ) {
+      printf("RIODequeueCompletion() reported a corrupt queue\n");
+      return SOCKET_ERROR;
+    }
+    ResultCount = count;
+    NextResult = 0;
+    if (count == 0)
+      return 0;
+  }
+  auto& result = Results[NextResult++];
+  auto slot = static_cast<ULONG>(result.RequestContext);
+  // failed receives (e.g. ICMP port unreachable) are dropped like any lost ack
+  int bytes = (result.Status == 0) ? static_cast<int>(min(static_cast<size_t>(result.BytesTransferred), packetLength)) : 0;
+  memcpy(packet, &ReceiveBuffer[slot * MAX_PKT_SIZE], bytes);
+  std::lock_guard<std::mutex> lock(QueueMutex);
+  if (!PostReceive(slot))
+    return SOCKET_ERROR;
+  return bytes;
+}
+
+int RioEngine::Receive(char* packet, size_t packetLength, INT64 micros)
+{
+  LARGE_INTEGER now;
+  QueryPerformanceCounter(&now);
+  auto deadline = now.QuadPart + micros * TicksPerSecond / 1000000;
+  while (true) {
+    auto bytes = TryReceive(packet, packetLength);
+    if (bytes != 0)
+      return bytes;
+    if (NextResult != ResultCount)
+      continue;
+    QueryPerformanceCounter(&now);
+    auto remainder = deadline - now.QuadPart;
+    if (remainder <= 0)
+      return 0;
+    // WaitForSingleObject would round a partial millisecond up, so that part is polled
+    auto millis = static_cast<DWORD>(remainder * 1000 / TicksPerSecond);
+    if (millis == 0) {
+      YieldProcessor();
+      continue;
+    }
+    // the event is signaled as soon as the queue holds a completion, which
+    // also covers one that arrived between the poll above and this call
+    auto error = Rio.RIONotify(ReceiveQueue);
+    if (error != ERROR_SUCCESS && error != WSAEALREADY) {
+      printf("failed RIONotify with error %d\n", error);
+      return SOCKET_ERROR;
+    }
+    auto wait = WaitForSingleObject(ReceiveEvent, millis);
+    if (wait == WAIT_TIMEOUT)
+      continue;
+    if (wait != WAIT_OBJECT_0) {
+      printf("WaitForSingleObject() generated error %d\n", GetLastError());
+      return SOCKET_ERROR;
+    }
+  }
+}
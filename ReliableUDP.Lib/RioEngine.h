@@ -0,0 +1,74 @@
+﻿// File: RioEngine.h
+// Martin Fracker
+// CSCE 463-500 Spring 2017
+#pragma once
+
+#define _WINSOCK_DEPRECATED_NO_WARNINGS
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <mswsock.h>
+#include <windows.h>
+#include <mutex>
+#include <vector>
+
+#define RIO_RECEIVE_SLOTS 64 // ack receives kept posted at all times
+#define RIO_RESULTS 64 // completions dequeued per call
+
+// Winsock Registered I/O. The retransmission ring is registered with the kernel
+// once and packets are posted straight from their slots; receives for acks stay
+// posted, and completions are polled from user space without a system call.
+// Request queues are not thread-safe, so every call on ours takes QueueMutex;
+// the sender and the ack thread may use the engine at the same time.
+class RioEngine
+{
+public:
+  RioEngine();
+  ~RioEngine();
+
+  // false if the kernel does not support registered I/O
+  bool Initialize(SOCKET socket);
+  // waits for outstanding sends and releases the queues and buffers; must run
+  // before the socket is closed. Safe to call more than once
+  void Shutdown();
+  // must be called before the first Send; a later call replaces the ring
+  bool RegisterRing(char* ring, size_t slotSize, size_t slots);
+  void SetRemote(const struct sockaddr_in& remote);
+
+  // slot must lie inside the registered ring and stay untouched until Reclaim(slot)
+  bool Send(const char* slot, size_t length);
+  // waits until the kernel has finished every send from slot, so it may be overwritten
+  void Reclaim(const char* slot);
+  // returns the datagram length, or 0 if nothing has completed yet
+  int TryReceive(char* packet, size_t packetLength);
+  // waits up to `micros`; returns the datagram length, 0 on timeout, SOCKET_ERROR on failure.
+  // Whole milliseconds are slept on the completion event, so the wakeup is only as
+  // precise as the system timer; the sub-millisecond remainder is polled
+  int Receive(char* packet, size_t packetLength, INT64 micros);
+
+private:
+  SOCKET Socket = INVALID_SOCKET;
+  RIO_EXTENSION_FUNCTION_TABLE Rio;
+  RIO_CQ SendQueue = RIO_INVALID_CQ;
+  RIO_CQ ReceiveQueue = RIO_INVALID_CQ;
+  RIO_RQ Requests = RIO_INVALID_RQ;
+  HANDLE ReceiveEvent = nullptr;
+  std::mutex QueueMutex;
+  char* Ring = nullptr;
+  size_t SlotSize = 1;
+  RIO_BUFFERID RingId = RIO_INVALID_BUFFERID;
+  std::vector<ULONG> Sending; // sends posted from each slot and not yet reaped
+  ULONG Outstanding = 0; // all of them
+  std::vector<char> ReceiveBuffer;
+  RIO_BUFFERID ReceiveId = RIO_INVALID_BUFFERID;
+  SOCKADDR_INET Remote;
+  RIO_BUFFERID RemoteId = RIO_INVALID_BUFFERID;
+  RIORESULT Results[RIO_RESULTS];
+  ULONG ResultCount = 0;
+  ULONG NextResult = 0;
+  INT64 TicksPerSecond = 1;
+
+  // these three expect QueueMutex to be held
+  void ReapSends();
+  void DrainSends();
+  bool PostReceive(ULONG slot);
+};
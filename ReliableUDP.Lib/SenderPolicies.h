@@ -0,0 +1,147 @@
+﻿// File: SenderPolicies.h
+// Martin Fracker
+// CSCE 463-500 Spring 2017
+#pragma once
+
+#define _WINSOCK_DEPRECATED_NO_WARNINGS
+#include <winsock2.h>
+#include <windows.h>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+
+// Policies BasicSenderSocket is built from. Each is a plain class whose members are
+// defined here, in the header, so calls to them inline into the protocol code and
+// the empty ones disappear. A policy set is a struct naming one of each:
+//   IoEngine              see SocketIo.h
+//   Clock                 float Seconds() const, since construction
+//   CongestionController  Reset, OnAck, GetWindow, GetCeCount (see EcnCongestionControl)
+//   Tracer                Sent, Acked, Connected (see NullTracer)
+//   RtoEstimator          MaxAttempts, Start, Limit, Sample and getters (see JacobsonRto)
+
+// timeGetTime(), millisecond resolution
+class SystemClock
+{
+public:
+  SystemClock() : Start(timeGetTime()) {}
+  float Seconds() const { return static_cast<float>(timeGetTime() - Start) / 1000; }
+
+private:
+  DWORD Start;
+};
+
+// Shrinks the window (in packets) on CE marks echoed by the receiver and grows it back
+// by about a packet per window of acks, never past the sender's own window
+class EcnCongestionControl
+{
+public:
+  void Reset(float maximum)
+  {
+    Window = Maximum = maximum;
+    CeCount = 0;
+    RecoverSequence = 0;
+  }
+  // base is the new cumulative ack; ceCount the CE marks the receiver has counted so far
+  void OnAck(DWORD ceCount, DWORD ackedPackets, INT64 base, UINT64 lastSent)
+  {
+    if (ceCount != CeCount)
+    {
+      // halve at most once per window of data, like TCP's CWR, and stay
+      // below the point where the router queue would overflow
+      if (base >= static_cast<INT64>(RecoverSequence))
+      {
+        Window = max(Window / 2, 1.f);
+        RecoverSequence = lastSent + 1;
+      }
+      CeCount = ceCount;
+    } else
+    {
+      Window = min(Window + ackedPackets / Window, Maximum);
+    }
+  }
+  float GetWindow() const { return Window; }
+  DWORD GetCeCount() const { return CeCount; }
+
+private:
+  float Window = 1;
+  float Maximum = 1;
+  std::atomic<DWORD> CeCount = 0; // the stats thread reads it
+  UINT64 RecoverSequence = 0; // no further reduction until the base passes this
+};
+
+// Traces nothing. Its members take the clock rather than a timestamp, so with this
+// tracer not even the clock is read.
+class NullTracer
+{
+public:
+  template <class Clock> void Sent(const Clock&, const char*, UINT64, size_t, size_t, float) {}
+  template <class Clock> void Acked(const Clock&, const char*, DWORD, DWORD) {}
+  template <class Clock> void Connected(const Clock&, DWORD, DWORD, float) {}
+};
+
+// Every packet sent and every ack received, on stdout
+class ConsoleTracer
+{
+public:
+  template <class Clock> void Sent(const Clock& clock, const char* packetType, UINT64 sequence, size_t attempt, size_t maximumAttempts, float rto)
+  {
+    printf("[%6.3f] --> %s %llu (attempt %zu of %zu, Rto %.3f)\n", clock.Seconds(), packetType, sequence, attempt, maximumAttempts, rto);
+  }
+  template <class Clock> void Acked(const Clock& clock, const char* packetType, DWORD ack, DWORD window)
+  {
+    printf("[%6.3f] <-- %s %lu window %lX\n", clock.Seconds(), packetType, ack, window);
+  }
+  template <class Clock> void Connected(const Clock& clock, DWORD ack, DWORD window, float rto)
+  {
+    printf("[%6.3f] <-- SYN-ACK %lu window %lX; setting initial RTO to %.3f\n", clock.Seconds(), ack, window, rto);
+  }
+};
+
+// what debug and release builds trace by default
+#if _DEBUG
+typedef ConsoleTracer DefaultTracer;
+#else
+typedef NullTracer DefaultTracer;
+#endif
+
+#define MIN_DEVIATION 0.010f // floor on the RTT deviation the RTO is built from (in sec)
+
+// Jacobson/Karels: smoothed RTT and deviation with gains 1/AlphaInverse and 1/BetaInverse,
+// RTO = SRTT + 4 * max(RTTVAR, 10 ms). The sender gives up on a packet after Attempts sends.
+template <int AlphaInverse, int BetaInverse, int Attempts>
+class JacobsonRto
+{
+public:
+  static const int MaxAttempts = Attempts;
+
+  // the handshake's RTT. The RTO keeps the floor Sample() puts on the deviation, or a
+  // handshake the millisecond clock times at zero would start it at zero
+  void Start(float rtt)
+  {
+    EstimatedRtt = rtt;
+    Rto = max(2 * rtt, rtt + 4 * MIN_DEVIATION);
+  }
+  void Limit(float ceiling) { Rto = min(Rto, ceiling); }
+  void Sample(float rtt)
+  {
+    const float alpha = 1.f / AlphaInverse;
+    const float beta = 1.f / BetaInverse;
+    EstimatedRtt = (1 - alpha) * OldEstimatedRtt + alpha * rtt;
+    RttDeviation = (1 - beta) * OldRttDeviation + beta * fabs(rtt - EstimatedRtt);
+    Rto = EstimatedRtt + 4 * max(RttDeviation, MIN_DEVIATION);
+    if (MinRtt == 0 || rtt < MinRtt)
+      MinRtt = rtt;
+    OldEstimatedRtt = EstimatedRtt;
+    OldRttDeviation = RttDeviation;
+  }
+
+  float GetRto() const { return Rto; }
+  float GetEstimatedRtt() const { return EstimatedRtt; }
+  float GetMinRtt() const { return MinRtt; }
+
+private:
+  float Rto = 1.;
+  // only the ack thread samples, but the others read the estimates
+  std::atomic<float> EstimatedRtt = 0, MinRtt = 0;
+  float RttDeviation = 0, OldEstimatedRtt = 0, OldRttDeviation = 0;
+};
@@ -4,10 +4,17 @@
 #pragma once
 
 #include <cstring>
+#define _WINSOCK_DEPRECATED_NO_WARNINGS // inet_addr, inet_ntoa and gethostbyname are deprecated in winsock2
+#include <winsock2.h>
 #include <windows.h>
 #include <mutex>
 #include <vector>
 #include "Semaphore.h"
+#include "SocketIo.h"
+#include "SenderPolicies.h"
+#include "StreamScheduler.h"
+#include "Delta.h"
+#include "HeaderCodec.h"
 
 #define MAGIC_PORT 22345 // receiver listens on this port
 #define MAX_PKT_SIZE (1500-28) // maximum UDP packet size accepted by receiver 
@@ -20,13 +27,27 @@
 #define FAILED_SEND 4 // sendto() failed in kernel
 #define TIMEOUT 5 // timeout after all retx attempts are exhausted
 #define FAILED_RECV 6 // recvfrom() failed in kernel
+#define FAILED_MAP 7 // receiver could not create or map its destination file
+#define INVALID_STREAM 8 // ss.OpenStream() with a duplicate id, or ss.Write() to a stream that was never opened
 
+#define TAIL_PROBE 96 // non-fatal probe timeout
 #define FAST_RETX 97 // non-fatal timeout error 
 #define INVALID_ACK 98 //non-fatal ack error
 #define SELECT_TIMEOUT 99 // non-fatal timeout error 
 
 #define MAGIC_PROTOCOL 0x8311AA
 
+// ECN codepoints in the low two bits of the IP TOS byte
+#define ECN_NOT_ECT 0
+#define ECN_ECT0 2
+#define ECN_CE 3
+#ifndef IP_RECVTOS
+#define IP_RECVTOS 40 // deliver the TOS byte with WSARecvMsg
+#endif
+#ifndef IP_ECN
+#define IP_ECN 50 // set the ECN codepoint with WSASendMsg
+#endif
+
 #define BITS_IN_MEGABIT 1e6
 #define BITS_IN_KILOBIT 1000
 #define BYTES_IN_MEGABYTE (1 << 20)
@@ -36,10 +57,16 @@
 #define RETURN_PATH 1
 
 #define MAX_RETX 50 
+#define BITS_IN_WORD 64
+#define MIN_PROBE_TIMEOUT 0.010 // floor on the tail-loss probe timeout (in sec)
 
 #pragma pack(push, 1)
 struct Flags {
-  DWORD Reserved : 5; // must be zero
+  DWORD Compact : 1; // must be zero; set only in the first byte of a v2 header (see HeaderCodec.h)
+  DWORD V2 : 1; // SYN: sender can send v2 data headers; SYN-ACK: receiver accepts them
+  DWORD Resume : 1; // SYN: a ResumeRequest follows; SYN-ACK: the reply is a ReceiverResumeHeader
+  DWORD Ecn : 1; // SYN: sender is ECN-capable; receiver replies: ECN is on and the reply is a ReceiverEcnHeader
+  DWORD Stream : 1; // a StreamHeader follows the SenderDataHeader
   DWORD Syn : 1;
   DWORD Ack : 1;
   DWORD Fin : 1;
@@ -48,7 +75,12 @@ struct Flags {
 };
 struct SenderDataHeader {
   Flags Flags;
-  DWORD Sequence; // must begin from 0
+  DWORD Sequence; // must begin from 0; low 32 bits of the 64-bit sequence
+};
+struct StreamHeader {
+  WORD StreamId;
+  WORD Reserved; // must be zero
+  DWORD StreamSequence; // position of the packet within its stream, from 0
 };
 struct LinkProperties {
   // transfer parameters
@@ -62,49 +94,137 @@ struct SenderSynHeader {
   SenderDataHeader SenderDataHeader;
   LinkProperties LinkProperties;
 };
+struct ResumeRequest {
+  UINT64 TransferId; // nonzero; names the transfer across connections
+};
+struct SenderResumeSynHeader {
+  SenderSynHeader SenderSynHeader;
+  ResumeRequest ResumeRequest;
+};
 struct ReceiverHeader {
   Flags Flags;
   DWORD ReceiverWindow; // receiver window for flow control (in pkts)
-  DWORD AckSequence; // ack value = next expected sequence
+  DWORD AckSequence; // ack value = next expected sequence; low 32 bits, the sender restores the rest
+};
+struct ReceiverEcnHeader {
+  ReceiverHeader ReceiverHeader;
+  DWORD CeCount; // data packets that arrived marked CE so far
+};
+#define RESUME_BITMAP_WORDS ((MAX_PKT_SIZE - sizeof(ReceiverEcnHeader) - 2 * sizeof(UINT64) - sizeof(DWORD)) / sizeof(UINT64)) // as many as fit in one datagram
+struct ReceiverResumeHeader {
+  ReceiverEcnHeader ReceiverEcnHeader; // CeCount only means something when Flags.Ecn is set
+  UINT64 TransferId;
+  UINT64 ResumeSequence; // every packet below this was received by an earlier connection
+  DWORD BitmapWords; // words of Bitmap that were sent
+  UINT64 Bitmap[RESUME_BITMAP_WORDS]; // bit i of word j: packet (ResumeSequence / BITS_IN_WORD + j) * BITS_IN_WORD + i was received
 };
 #pragma pack(pop)
 
+#define STREAM_PAYLOAD_SIZE (MAX_PKT_SIZE - sizeof(SenderDataHeader) - sizeof(StreamHeader)) // stream bytes per packet
+
 struct PacketBufferElement
 {
-  PacketBufferElement(std::string pkt, size_t pktLength, float timeStamp, bool retransmitted) : Packet(pkt), PacketLength(pktLength), TimeStamp(timeStamp), Retransmitted(retransmitted) {}
-  PacketBufferElement() : PacketBufferElement("", 0, 0, false) {}
-  std::string Packet;
+  PacketBufferElement(char* pkt, size_t pktLength, float timeStamp, bool retransmitted) : Packet(pkt), PacketLength(pktLength), TimeStamp(timeStamp), Retransmitted(retransmitted) {}
+  PacketBufferElement() : PacketBufferElement(nullptr, 0, 0, false) {}
+  char* Packet; // slot in the retransmission ring
   size_t PacketLength;
   float TimeStamp;
   bool Retransmitted;
 };
 
-class SenderSocket
+// what SenderSocket is built from
+struct DefaultSenderPolicies
+{
+  typedef SocketIo IoEngine;
+  typedef SystemClock Clock;
+  typedef EcnCongestionControl CongestionController;
+  typedef DefaultTracer Tracer;
+  typedef JacobsonRto<8, 4, MAX_RETX> RtoEstimator; // gains 1/8 and 1/4
+};
+
+// the same, tracing every packet in release builds too
+struct TracingSenderPolicies : DefaultSenderPolicies
+{
+  typedef ConsoleTracer Tracer;
+};
+
+// retransmissions so far, by the timer that caused them
+struct LossRecoveryStats
+{
+  size_t Timeouts = 0;
+  size_t FastRetransmissions = 0; // three duplicate acks or a RACK deadline
+  size_t TailProbes = 0;
+};
+
+// The sender, built from the policies in SenderPolicies.h. Member definitions live in
+// SenderSocket.inl; SenderSocket.cpp instantiates the policy sets above, and code
+// built with another set includes SenderSocket.inl and instantiates it itself.
+template <class Policies>
+class BasicSenderSocket
 {
 public:
-  SenderSocket();
-  ~SenderSocket();
+  // registeredIo asks for the Registered I/O engine; sendto/recvfrom are used if the kernel lacks it
+  explicit BasicSenderSocket(bool registeredIo = false);
+  ~BasicSenderSocket();
   int ReceivePacket(char* packet, size_t packetLength, bool printTimestamp);
 
   int Open(const char* host, DWORD port, DWORD senderWindow, LinkProperties* lp);
+  // Resumable transfer. The receiver answers with what it already holds of transferId and
+  // Send() silently skips those chunks, so the caller still sends the whole buffer from the
+  // start. Only the receiver keeps a checkpoint; what it reports is all that is skipped.
+  int Open(const char* host, DWORD port, DWORD senderWindow, LinkProperties* lp, UINT64 transferId);
   int Send(const char* buffer, DWORD bytes);
+  // rsync-style delta: sends only literals and references to blocks the receiver's copy
+  // already holds (as described by its signature). The delta is encoded and sent a
+  // segment at a time; the receiver rebuilds the data with ReceiverSocket::ApplyDelta()
+  int SendDelta(const char* buffer, UINT64 bytes, const DeltaSignature& signature);
   int Close(float* transferTime);
 
-  float GetEstRTT() const { return EstimatedRtt; }
+  // Independent streams multiplexed over the connection, so a loss only stalls
+  // the stream it hit. Write() queues the caller's buffer, which must stay valid
+  // until Flush() has sent it; Flush() interleaves all streams through the shared window.
+  int OpenStream(WORD streamId, int priority = 0, DWORD weight = 1);
+  int Write(WORD streamId, const char* buffer, DWORD bytes);
+  int Flush();
+
+  float GetEstRTT() const { return Estimator.GetEstimatedRtt(); }
+
+  // offer ECN in the next Open's SYN. Off by default: receivers that predate it
+  // treat the bit as reserved
+  void SetEcn(bool enabled) { EcnRequested = enabled; }
+  // offer the compact v2 data header in the next Open's SYN; off by default for the same reason
+  void SetV2(bool enabled) { V2Requested = enabled; }
+
+  // trade CPU for ack latency; may be called at any time. False if the core cannot be used,
+  // in which case nothing changes
+  bool SetLowLatency(const LowLatencyOptions& options);
+  LowLatencyStats GetLowLatencyStats();
+  LossRecoveryStats GetLossRecoveryStats() const;
+  // the engine every packet goes through, so tests can reach a LoopbackIo
+  typename Policies::IoEngine& GetIo() { return Io; }
 
 private:
+  typedef typename Policies::IoEngine IoEngine;
+  typedef typename Policies::Clock Clock;
+  typedef typename Policies::CongestionController CongestionController;
+  typedef typename Policies::Tracer Tracer;
+  typedef typename Policies::RtoEstimator RtoEstimator;
+
+  // declared before Io so that it outlives the registration
+  std::vector<char> PacketRing; // SenderWindow slots of MAX_PKT_SIZE bytes, indexed like PacketBuffer
+  IoEngine Io;
+  Clock Timer;
+  CongestionController Congestion;
+  Tracer Trace;
+  RtoEstimator Estimator;
   std::atomic<float> TransferTimeStart, TransferTimeEnd;
   int Status = STATUS_OK;
   std::atomic<bool> Connected = false;
-  DWORD ConstructionTime;
-  SOCKET Socket;
-  struct sockaddr_in Remote;
   int dupack = 0;
-  float Rto = 1.;
-  std::atomic<int> SenderBase;
+  std::atomic<INT64> SenderBase; // -1 until the SYN is acked
   std::atomic<size_t> BytesAcked = 0;
-  std::atomic<UINT32> NextSequence;
-  std::atomic<UINT32> CurrentSequence = 0;
+  std::atomic<UINT64> NextSequence;
+  std::atomic<UINT64> CurrentSequence = 0;
   UINT32 SenderWindow;
   UINT32 ReceiverWindow;
   std::thread AckThread;
@@ -124,27 +244,50 @@ private:
   std::atomic<UINT32> EffectiveWindow;
   bool KillAckThread = false;
   std::vector<PacketBufferElement> PacketBuffer;
-  std::atomic<float> OldRttDeviation = 0, RttDeviation = 0, OldEstimatedRtt = 0, EstimatedRtt = 0, TimeMark;
+  std::atomic<float> TimeMark;
   size_t AllTimeoutsSnapshot = 0;
   std::atomic<size_t> TotalFastRetransmissions = 0;
   size_t Dupacks = 0;
   float Timeout = 1;
+  int PendingTimer = TIMEOUT; // which timer CalculateTimeout() picked: TIMEOUT, FAST_RETX or TAIL_PROBE
+  std::atomic<float> RackXmitTime = 0; // send time of the most recently sent packet known to be delivered
+  std::atomic<UINT64> LastSentSequence = 0;
+  std::atomic<float> ProbeAnchor = 0; // probe timer runs from the last new transmission or forward ack
+  std::atomic<bool> ProbeSent = false;
+  std::atomic<bool> WindowBlocked = false; // Send() is waiting for a window slot
+  std::atomic<size_t> TotalTailProbes = 0;
+  StreamScheduler Streams;
+  bool UseV2 = false; // data packets carry the compact v2 header
+  DWORD SequenceBytes = V2_MAX_SEQUENCE_BYTES;
+  bool EcnRequested = false;
+  bool V2Requested = false;
+  std::atomic<bool> EcnEnabled = false;
+  UINT64 TransferId = 0;
+  UINT64 ResumeSequence = 0; // first packet the receiver is missing
+  std::vector<UINT64> ResumeBitmap; // packets it holds past that, from word ResumeSequence / BITS_IN_WORD on
+  UINT64 PrefixSkipped = 0; // Send() calls absorbed by the resumed prefix
+  INT64 LastReleased = 0; // window slots handed to EmptySlots, counted in sequence numbers
 
-  bool RemoteInfoFromHost(const char* host, DWORD port);
-  bool SendPacket(const char* pkt, size_t pktLength, bool bypassSemaphore = false, int sequenceOverride = -1);
-  void PrintSendAttempt(const char* packetType, DWORD sequence, size_t maximumAttempts, size_t attempt);
-  void PrintAckReception(const char* packetType, ReceiverHeader rh);
-  void PrintAckReceptionNonDebug(const char* packetType, ReceiverHeader rh);
+  bool SendPacket(const char* pkt, size_t pktLength, bool bypassSemaphore = false, INT64 sequenceOverride = -1);
+  void ApplyResume(const ReceiverResumeHeader& header);
+  bool Resumed(UINT64 sequence) const;
+  UINT64 ResumedBetween(UINT64 first, UINT64 last) const;
   void AckPackets();
-  void PrintStats() const;
-  bool AckIsValid(DWORD ack, bool isFin) const;
+  void PrintStats();
+  bool AckIsValid(UINT64 ack, bool isFin) const;
+  UINT64 AckOf(const ReceiverHeader& rh) const;
   void StartTimer();
-  void RecordRto(float rtt);
+  void RecordDelivery(INT64 sequence);
+  bool RackDeadline(float* deadline);
+  float ReorderWindow() const;
+  void WaitForWindow();
+  bool AtTail() const;
   void WaitUntilConnectedOrAborted();
   void WaitUntilDisconnectedOrAborted();
-  PacketBufferElement& GetPacketBufferElement(int sequence);
-  float GetTimeStamp(int sequence);
+  PacketBufferElement& GetPacketBufferElement(INT64 sequence);
+  float GetTimeStamp(INT64 sequence);
 
-  const char* Ip() const { return inet_ntoa(Remote.sin_addr); }
-  float Time() const { return static_cast<float>(timeGetTime() - ConstructionTime) / 1000; }
+  float Time() const { return Timer.Seconds(); }
 };
+
+typedef BasicSenderSocket<DefaultSenderPolicies> SenderSocket;
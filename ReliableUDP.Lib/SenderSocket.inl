@@ -0,0 +1,624 @@
+﻿// File: SenderSocket.inl
+// Martin Fracker
+// CSCE 463-500 Spring 2017
+#pragma once
+
+#include "SenderSocket.h"
+#include <windows.h>
+#include <cstdio>
+#include <string>
+#include <algorithm>
+
+// BasicSenderSocket's member definitions. SenderSocket.cpp instantiates the policy
+// sets SenderSocket.h declares; any other set includes this file where it is used.
+
+template <class Policies>
+BasicSenderSocket<Policies>::BasicSenderSocket(bool registeredIo)
+  : SenderBase(-1), NextSequence(0), SenderWindow(1), FullSlots(0), EmptySlots(1), EffectiveWindow(1), PacketBuffer(1)
+{
+  Io.Initialize(registeredIo);
+  SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL);
+  // start ack thread
+  AckThread = std::thread(&BasicSenderSocket::AckPackets, this);
+}
+
+template <class Policies>
+BasicSenderSocket<Policies>::~BasicSenderSocket()
+{
+  AckThread.join();
+  StatsThread.join();
+}
+
+template <class Policies>
+bool BasicSenderSocket<Policies>::AckIsValid(UINT64 ack, bool isFin) const
+{
+  if (isFin)
+  {
+    ack += 1;
+  }
+  // an ack may run ahead of Send() over packets an earlier connection delivered
+  return static_cast<INT64>(ack) > SenderBase && (ack <= NextSequence || ResumedBetween(NextSequence, ack) == ack - NextSequence);
+}
+
+template <class Policies>
+UINT64 BasicSenderSocket<Policies>::AckOf(const ReceiverHeader& rh) const
+{
+  // acks never stray more than a window from the base, so 32 bits pin down the rest
+  return HeaderCodec::Expand(rh.AckSequence, sizeof(rh.AckSequence), max(SenderBase.load(), 0LL));
+}
+
+template <class Policies>
+void BasicSenderSocket<Policies>::StartTimer()
+{
+  auto index = SenderBase.load();
+  if (index == -1)
+    index = 0;
+  TimeMark = Time();
+  Timeout = PacketBuffer[index % SenderWindow].TimeStamp + Estimator.GetRto();
+}
+
+template <class Policies>
+void BasicSenderSocket<Policies>::RecordDelivery(INT64 sequence)
+{
+  // only packets still in flight carry a useful send time
+  sequence = min(sequence, static_cast<INT64>(LastSentSequence.load()));
+  if (sequence < SenderBase)
+    return;
+  RackXmitTime = max(RackXmitTime.load(), GetTimeStamp(sequence));
+}
+
+template <class Policies>
+bool BasicSenderSocket<Policies>::RackDeadline(float* deadline)
+{
+  // the base is lost once something sent after it was delivered and it is
+  // still unacknowledged a reordering window past its expected ack time
+  auto sent = GetTimeStamp(SenderBase);
+  if (RackXmitTime <= sent)
+    return false;
+  *deadline = sent + Estimator.GetEstimatedRtt() + ReorderWindow();
+  return true;
+}
+
+template <class Policies>
+float BasicSenderSocket<Policies>::ReorderWindow() const
+{
+  auto rtt = (Estimator.GetMinRtt() > 0) ? Estimator.GetMinRtt() : Estimator.GetEstimatedRtt();
+  return rtt / 4;
+}
+
+template <class Policies>
+int BasicSenderSocket<Policies>::Open(const char* host, DWORD port, DWORD senderWindow, LinkProperties* lp)
+{
+  return Open(host, port, senderWindow, lp, 0);
+}
+
+template <class Policies>
+int BasicSenderSocket<Policies>::Open(const char* host, DWORD port, DWORD senderWindow, LinkProperties* lp, UINT64 transferId)
+{
+  if (Connected)
+    return ALREADY_CONNECTED;
+  if (!Io.Connect(host, port))
+    return INVALID_NAME;
+  auto win = senderWindow;
+  SenderWindow = win;
+  PacketBuffer = std::vector<PacketBufferElement>(SenderWindow);
+  // the old ring stays alive until RegisterRing has drained and deregistered it
+  std::vector<char> ring(SenderWindow * MAX_PKT_SIZE);
+  Io.RegisterRing(ring.data(), MAX_PKT_SIZE, SenderWindow);
+  PacketRing.swap(ring);
+  TransferId = transferId;
+  SenderResumeSynHeader synHeader;
+  auto& syn = synHeader.SenderSynHeader;
+  syn.LinkProperties = *lp;
+  syn.LinkProperties.BufferSize = senderWindow + RtoEstimator::MaxAttempts;
+  syn.SenderDataHeader.Flags.Syn = 1;
+  syn.SenderDataHeader.Flags.Ecn = EcnRequested;
+  syn.SenderDataHeader.Flags.Resume = TransferId != 0;
+  syn.SenderDataHeader.Flags.V2 = V2Requested;
+  syn.SenderDataHeader.Sequence = 0;
+  synHeader.ResumeRequest.TransferId = TransferId;
+  Congestion.Reset(static_cast<float>(SenderWindow));
+  if (!SendPacket((char*)(&synHeader), (TransferId != 0) ? sizeof(SenderResumeSynHeader) : sizeof(SenderSynHeader)))
+    return FAILED_SEND;
+  WaitUntilConnectedOrAborted();
+  NextSequence = CurrentSequence.load();
+  Estimator.Limit(1);
+  StatsThread = std::thread(&BasicSenderSocket::PrintStats, this);
+  return Status;
+}
+
+template <class Policies>
+bool BasicSenderSocket<Policies>::SendPacket(const char* pkt, size_t pktLength, bool bypassSemaphore, INT64 sequenceOverride)
+{
+  if (!bypassSemaphore)
+    WaitForWindow();
+  std::unique_lock<std::mutex> lock(Mutex); // will guarantee unlock upon destruction
+  if (Status != STATUS_OK)
+    return false;
+  // new packets arrive with a v1 header; retransmissions come from the ring, possibly already in v2
+  SenderDataHeader* sdh = (SenderDataHeader*)pkt;
+  bool compact = (pkt[0] & V2_MARKER) != 0;
+  UINT64 sequence = max(sequenceOverride, 0LL);
+  if (!bypassSemaphore)
+  {
+    sequence = CurrentSequence.load();
+    sdh->Sequence = static_cast<DWORD>(sequence);
+    LastSentSequence = sequence;
+    ProbeAnchor = Time();
+    ProbeSent = false;
+  }
+  if (!compact && sdh->Flags.Fin)
+  {
+    Trace.Sent(Timer, "FIN", sequence, Timeouts + 1, RtoEstimator::MaxAttempts, Estimator.GetRto());
+    FinSent = true;
+  } else if (!compact && sdh->Flags.Syn)
+  {
+    Trace.Sent(Timer, "SYN", sequence, Timeouts + 1, RtoEstimator::MaxAttempts, Estimator.GetRto());
+  } else
+  {
+    Trace.Sent(Timer, "data", sequence, Timeouts + 1, RtoEstimator::MaxAttempts, Estimator.GetRto());
+    if (sequence == ResumeSequence)
+      TransferTimeStart = Time();
+  }
+  // packets live in their ring slot until acked and are always sent from there
+  auto slot = &PacketRing[(sequence % SenderWindow) * MAX_PKT_SIZE];
+  // the slot's previous packet may still be on its way out
+  if (slot != pkt)
+    Io.Reclaim(slot);
+  if (slot != pkt && UseV2 && !sdh->Flags.Syn && !sdh->Flags.Fin)
+  {
+    auto headerLength = HeaderCodec::Encode(slot, sequence, SequenceBytes, sdh->Flags.Stream);
+    memcpy(slot + headerLength, pkt + sizeof(SenderDataHeader), pktLength - sizeof(SenderDataHeader));
+    pktLength = headerLength + pktLength - sizeof(SenderDataHeader);
+  } else if (slot != pkt)
+  {
+    memcpy(slot, pkt, pktLength);
+  }
+  if (!Io.Send(slot, pktLength))
+  {
+    Status = FAILED_SEND;
+    return false;
+  }
+  auto retransmitted = bypassSemaphore;
+  PacketBuffer[sequence % SenderWindow] = PacketBufferElement(slot, pktLength, Time(), retransmitted);
+  lock.unlock();
+  lock.release();
+  FullSlots.Signal();
+  Status = STATUS_OK;
+  return true;
+}
+
+template <class Policies>
+void BasicSenderSocket<Policies>::ApplyResume(const ReceiverResumeHeader& header)
+{
+  ResumeSequence = header.ResumeSequence;
+  auto words = min(static_cast<size_t>(header.BitmapWords), RESUME_BITMAP_WORDS);
+  ResumeBitmap.assign(header.Bitmap, header.Bitmap + words);
+  // the window now starts at the first missing packet, with the same slots released past it
+  SenderBase = ResumeSequence;
+  CurrentSequence = ResumeSequence;
+  NextSequence = ResumeSequence;
+  LastSentSequence = ResumeSequence;
+  LastReleased += ResumeSequence;
+}
+
+template <class Policies>
+bool BasicSenderSocket<Policies>::Resumed(UINT64 sequence) const
+{
+  if (sequence < ResumeSequence)
+    return true;
+  auto word = sequence / BITS_IN_WORD - ResumeSequence / BITS_IN_WORD;
+  return word < ResumeBitmap.size() && (ResumeBitmap[word] >> (sequence % BITS_IN_WORD)) & 1;
+}
+
+template <class Policies>
+UINT64 BasicSenderSocket<Policies>::ResumedBetween(UINT64 first, UINT64 last) const
+{
+  // packets in [first, last) the receiver already had; nothing past the bitmap counts
+  last = min(last, (ResumeSequence / BITS_IN_WORD + ResumeBitmap.size()) * BITS_IN_WORD);
+  UINT64 count = 0;
+  for (auto sequence = max(first, ResumeSequence); sequence < last; ++sequence)
+    count += Resumed(sequence);
+  return count;
+}
+
+template <class Policies>
+float BasicSenderSocket<Policies>::CalculateTimeout()
+{
+  Timeout = GetTimeStamp(SenderBase) + Estimator.GetRto();
+  PendingTimer = TIMEOUT;
+  float deadline;
+  if (RackDeadline(&deadline) && deadline < Timeout)
+  {
+    Timeout = deadline;
+    PendingTimer = FAST_RETX;
+  }
+  // one tail-loss probe per flight, so losses at the end of a burst
+  // (or of the FIN) are repaired without waiting for the RTO
+  if (Connected && !ProbeSent && AtTail())
+  {
+    deadline = ProbeAnchor + max(2 * Estimator.GetEstimatedRtt(), MIN_PROBE_TIMEOUT);
+    if (deadline < Timeout)
+    {
+      Timeout = deadline;
+      PendingTimer = TAIL_PROBE;
+    }
+  }
+  return Timeout;
+}
+
+
+template <class Policies>
+int BasicSenderSocket<Policies>::ReceivePacket(char* packet, size_t packetLength, bool printTimestamp)
+{
+  auto remainder = max(CalculateTimeout() - Time(), 0.f);
+  int bytes;
+  while ((bytes = Io.Receive(packet, packetLength, remainder)) > 0) {
+    ReceiverHeader* rh = (ReceiverHeader*)packet;
+    auto ack = AckOf(*rh);
+    if (AckIsValid(ack, rh->Flags.Fin)) {
+      RecordDelivery(ack - 1);
+      // packets delivered by an earlier connection were never timed by this one
+      if (AllTimeoutsSnapshot == TotalTimeouts + TotalFastRetransmissions + TotalTailProbes && !Resumed(ack - 1)) {
+        Estimator.Sample(Time() - GetTimeStamp(ack - 1));
+      } else
+      {
+        AllTimeoutsSnapshot = TotalTimeouts + TotalFastRetransmissions + TotalTailProbes;
+      }
+      return STATUS_OK;
+    }
+    if (static_cast<INT64>(ack) == SenderBase)
+    {
+      ++Dupacks;
+      // Acks are cumulative only, so which packet a duplicate reports is a guess: the
+      // next one past the hole, as if the rest of the flight arrives in order. Reordering
+      // or further losses make the guess too late, never too early, since at least
+      // Dupacks packets past the base must have arrived; the reorder window absorbs it.
+      RecordDelivery(SenderBase + Dupacks);
+      float deadline;
+      if (Dupacks == 3 || (RackDeadline(&deadline) && Time() >= deadline))
+      {
+        return FAST_RETX;
+      }
+    }
+    if (!FinSent) {
+      remainder = max(CalculateTimeout() - Time(), 0.f);
+    }
+  }
+  if (bytes == SOCKET_ERROR)
+    return FAILED_RECV;
+  return PendingTimer;
+}
+
+template <class Policies>
+bool BasicSenderSocket<Policies>::SetLowLatency(const LowLatencyOptions& options)
+{
+  // an affinity mask has one bit per core
+  if (options.Core >= static_cast<int>(sizeof(DWORD_PTR) * BITS_IN_BYTE))
+  {
+    printf("core %d is out of range\n", options.Core);
+    return false;
+  }
+  if (options.Core >= 0 && SetThreadAffinityMask(AckThread.native_handle(), static_cast<DWORD_PTR>(1) << options.Core) == 0)
+  {
+    printf("SetThreadAffinityMask() generated error %d\n", GetLastError());
+    return false;
+  }
+  Io.SetSpin(options.SpinMicroseconds);
+  return true;
+}
+
+template <class Policies>
+LowLatencyStats BasicSenderSocket<Policies>::GetLowLatencyStats()
+{
+  LowLatencyStats stats;
+  Io.GetStats(&stats);
+  FILETIME creation, exit, kernel, user;
+  if (GetThreadTimes(AckThread.native_handle(), &creation, &exit, &kernel, &user))
+  {
+    auto toSeconds = [](const FILETIME& ft) { return ((static_cast<UINT64>(ft.dwHighDateTime) << 32) | ft.dwLowDateTime) / 1e7; };
+    stats.AckThreadCpuSeconds = toSeconds(kernel) + toSeconds(user);
+  }
+  return stats;
+}
+
+template <class Policies>
+LossRecoveryStats BasicSenderSocket<Policies>::GetLossRecoveryStats() const
+{
+  LossRecoveryStats stats;
+  stats.Timeouts = TotalTimeouts;
+  stats.FastRetransmissions = TotalFastRetransmissions;
+  stats.TailProbes = TotalTailProbes;
+  return stats;
+}
+
+template <class Policies>
+int BasicSenderSocket<Policies>::Send(const char* buffer, DWORD bytes) {
+  // chunks an earlier connection delivered are not sent again
+  if (PrefixSkipped < ResumeSequence)
+  {
+    ++PrefixSkipped;
+    return Status;
+  }
+  if (Resumed(CurrentSequence))
+  {
+    // the sequence still passes through the window, as if sent and acked at once
+    WaitForWindow();
+    ++CurrentSequence;
+    NextSequence = CurrentSequence.load();
+    return Status;
+  }
+  char pkt[MAX_PKT_SIZE];
+  SenderDataHeader senderHeader;
+  memcpy(pkt + sizeof(SenderDataHeader), buffer, bytes);
+  memcpy(pkt, &senderHeader, sizeof(SenderDataHeader));
+  SendPacket(pkt, bytes + sizeof(SenderDataHeader));
+  ++CurrentSequence;
+  NextSequence = CurrentSequence.load();
+  return Status;
+}
+
+template <class Policies>
+int BasicSenderSocket<Policies>::SendDelta(const char* buffer, UINT64 bytes, const DeltaSignature& signature)
+{
+  if (!Connected)
+    return NOT_CONNECTED;
+  DeltaEncoder encoder(signature, buffer, bytes);
+  std::vector<char> delta;
+  const size_t chunk = MAX_PKT_SIZE - sizeof(SenderDataHeader);
+  while (!encoder.Done() && Status == STATUS_OK) {
+    encoder.Next(DELTA_SEGMENT, &delta);
+    // full packets go out now and the remainder waits for the next segment
+    auto ready = encoder.Done() ? delta.size() : delta.size() / chunk * chunk;
+    for (size_t offset = 0; offset < ready && Status == STATUS_OK; offset += chunk)
+      Send(delta.data() + offset, static_cast<DWORD>(min(chunk, ready - offset)));
+    delta.erase(delta.begin(), delta.begin() + ready);
+  }
+  return Status;
+}
+
+template <class Policies>
+int BasicSenderSocket<Policies>::OpenStream(WORD streamId, int priority, DWORD weight)
+{
+  if (!Streams.AddStream(streamId, priority, weight))
+    return INVALID_STREAM;
+  return STATUS_OK;
+}
+
+template <class Policies>
+int BasicSenderSocket<Policies>::Write(WORD streamId, const char* buffer, DWORD bytes)
+{
+  if (!Connected)
+    return NOT_CONNECTED;
+  if (!Streams.Enqueue(streamId, buffer, bytes))
+    return INVALID_STREAM;
+  return STATUS_OK;
+}
+
+template <class Policies>
+int BasicSenderSocket<Policies>::Flush()
+{
+  if (!Connected)
+    return NOT_CONNECTED;
+  char pkt[MAX_PKT_SIZE];
+  SenderDataHeader senderHeader;
+  senderHeader.Flags.Stream = 1;
+  StreamHeader streamHeader;
+  streamHeader.Reserved = 0;
+  auto payload = pkt + sizeof(SenderDataHeader) + sizeof(StreamHeader);
+  while (!Streams.Empty() && Status == STATUS_OK) {
+    auto bytes = Streams.Next(&streamHeader.StreamId, &streamHeader.StreamSequence, payload, STREAM_PAYLOAD_SIZE);
+    memcpy(pkt, &senderHeader, sizeof(SenderDataHeader));
+    memcpy(pkt + sizeof(SenderDataHeader), &streamHeader, sizeof(StreamHeader));
+    SendPacket(pkt, bytes + sizeof(SenderDataHeader) + sizeof(StreamHeader));
+    ++CurrentSequence;
+    NextSequence = CurrentSequence.load();
+  }
+  return Status;
+}
+
+template <class Policies>
+void BasicSenderSocket<Policies>::WaitForWindow()
+{
+  WindowBlocked = true;
+  EmptySlots.Wait();
+  WindowBlocked = false;
+}
+
+template <class Policies>
+bool BasicSenderSocket<Policies>::AtTail() const
+{
+  // a sender held back by the window still has data queued, and a stall then is the
+  // window's doing; only an idle sender (or the FIN) leaves a tail worth probing
+  return FinSent || !WindowBlocked;
+}
+
+template <class Policies>
+void BasicSenderSocket<Policies>::WaitUntilConnectedOrAborted()
+{
+  std::unique_lock<std::mutex> lock(Mutex);
+  Condition.wait(lock, [&] { return Connected || Status != STATUS_OK; });
+}
+
+template <class Policies>
+void BasicSenderSocket<Policies>::WaitUntilDisconnectedOrAborted()
+{
+  std::unique_lock<std::mutex> lock(Mutex);
+  Condition.wait(lock, [&] { return !Connected || Status != STATUS_OK; });
+}
+
+template <class Policies>
+PacketBufferElement& BasicSenderSocket<Policies>::GetPacketBufferElement(INT64 sequence)
+{
+  auto index = sequence;
+  if (index == -1)
+    index = 0;
+  return PacketBuffer[index % SenderWindow];
+}
+
+template <class Policies>
+float BasicSenderSocket<Policies>::GetTimeStamp(INT64 sequence)
+{
+  auto bufferElem = GetPacketBufferElement(sequence);
+  return bufferElem.TimeStamp;
+}
+
+template <class Policies>
+int BasicSenderSocket<Policies>::Close(float* transferTime)
+{
+  if (!Connected)
+    return NOT_CONNECTED;
+  SenderSynHeader synHeader;
+  synHeader.SenderDataHeader.Flags.Fin = 1;
+  synHeader.SenderDataHeader.Sequence = 0;
+  if (!SendPacket((char*)(&synHeader), sizeof(SenderSynHeader)))
+    return FAILED_SEND;
+  WaitUntilDisconnectedOrAborted();
+  *transferTime = TransferTimeEnd - TransferTimeStart;
+  return Status;
+}
+
+template <class Policies>
+void BasicSenderSocket<Policies>::AckPackets()
+{
+  SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL);
+  // large enough for a ReceiverResumeHeader; every reply starts with a ReceiverEcnHeader
+  char replyBuffer[MAX_PKT_SIZE];
+  ReceiverEcnHeader& reply = *(ReceiverEcnHeader*)replyBuffer;
+  ReceiverHeader& rh = reply.ReceiverHeader;
+  int receiveResult;
+  while (!KillAckThread) {
+    do {
+      if (!FinSent)
+        FullSlots.Wait();
+      receiveResult = ReceivePacket(replyBuffer, sizeof(replyBuffer), true);
+      std::unique_lock<std::mutex> lock(Mutex);
+      if (receiveResult == TIMEOUT) {
+        auto& bufferElem = GetPacketBufferElement(SenderBase);
+        ++Timeouts;
+        ++TotalTimeouts;
+        SenderDataHeader* sdh = (SenderDataHeader*)bufferElem.Packet;
+        lock.unlock();
+        lock.release();
+        SendPacket(bufferElem.Packet, bufferElem.PacketLength, true, SenderBase);
+      } else if (receiveResult == FAST_RETX)
+      {
+        Timeouts = 0;
+        auto& bufferElem = GetPacketBufferElement(SenderBase);
+        ++TotalFastRetransmissions;
+        SenderDataHeader* sdh = (SenderDataHeader*)bufferElem.Packet;
+        lock.unlock();
+        lock.release();
+        SendPacket(bufferElem.Packet, bufferElem.PacketLength, true, SenderBase);
+      } else if (receiveResult == TAIL_PROBE)
+      {
+        // resend the newest packet; its ack either repairs a lost tail
+        // or exposes an earlier hole to time-based loss detection
+        auto& bufferElem = GetPacketBufferElement(LastSentSequence);
+        // the sender may have filled the window since the probe was armed
+        auto atTail = AtTail();
+        ProbeSent = true;
+        lock.unlock();
+        lock.release();
+        if (atTail)
+        {
+          ++TotalTailProbes;
+          SendPacket(bufferElem.Packet, bufferElem.PacketLength, true, LastSentSequence);
+        } else
+        {
+          // nothing was sent, so hand back the in-flight count the loop took
+          FullSlots.Signal();
+        }
+      } else if (receiveResult != STATUS_OK) {
+        Status = receiveResult;
+        Connected = false;
+        Condition.notify_one();
+        EmptySlots.Signal();
+        return;
+      }
+      if (Timeouts >= RtoEstimator::MaxAttempts - 1)
+      {
+        Status = receiveResult;
+        Connected = false;
+        Condition.notify_one();
+        EmptySlots.Signal();
+        return;
+      }
+      if (receiveResult != TIMEOUT && receiveResult != FAST_RETX && receiveResult != TAIL_PROBE) {
+        lock.unlock();
+        lock.release();
+      }
+    } while (receiveResult != STATUS_OK);
+    auto ack = AckOf(rh);
+    if (AckIsValid(ack, rh.Flags.Fin)) {
+      std::unique_lock<std::mutex> lock(Mutex);
+      Dupacks = 0;
+      Timeouts = 0;
+      ProbeAnchor = Time();
+      ProbeSent = false;
+      auto base = max(SenderBase.load(), 0LL);
+      ++NextSequence;
+      auto ackedPackets = static_cast<INT64>(ack) - SenderBase;
+      // only packets this connection sent were signalled to FullSlots
+      auto sentPackets = static_cast<int>(ackedPackets - ResumedBetween(base, ack));
+      BytesAcked += sentPackets * MAX_PKT_SIZE;
+      SenderBase = ack;
+      if (EcnEnabled && rh.Flags.Ecn)
+        Congestion.OnAck(reply.CeCount, static_cast<DWORD>(ackedPackets), SenderBase, LastSentSequence);
+      EffectiveWindow = min(min(SenderWindow, rh.ReceiverWindow), static_cast<UINT32>(Congestion.GetWindow()));
+      auto newReleased = SenderBase + EffectiveWindow - LastReleased;
+      if (rh.Flags.Syn) {
+        Estimator.Start(Time() - TimeMark);
+        Trace.Connected(Timer, rh.AckSequence, rh.ReceiverWindow, Estimator.GetRto());
+        EcnEnabled = rh.Flags.Ecn;
+        Io.SetEcnCapable(EcnEnabled);
+        UseV2 = rh.Flags.V2;
+        SequenceBytes = HeaderCodec::SequenceBytes(SenderWindow);
+        if (rh.Flags.Resume && TransferId != 0)
+          ApplyResume(*(ReceiverResumeHeader*)replyBuffer);
+        Connected = true;
+        Condition.notify_one();
+      } else
+      { 
+        if (rh.Flags.Fin) {
+          printf("[%6.3f] <-- FIN-ACK %lu window %lX\n", Time(), rh.AckSequence, rh.ReceiverWindow);
+          Connected = false;
+          Condition.notify_one();
+          KillAckThread = true;
+        } else {
+          Trace.Acked(Timer, "ACK", rh.AckSequence, rh.ReceiverWindow);
+          TransferTimeEnd = Time();
+        }
+      }
+      lock.unlock();
+      lock.release();
+      EmptySlots.Signal(static_cast<int>(newReleased));
+      if (!FinSent)
+        FullSlots.WaitDeferred(sentPackets);
+      LastReleased += newReleased;
+    }
+  }
+}
+
+template <class Policies>
+void BasicSenderSocket<Policies>::PrintStats()
+{
+  const UINT64 interval = 2;
+  UINT64 seconds = interval;
+  while (true) {
+    std::this_thread::sleep_for(std::chrono::seconds(interval));
+    if (!Connected)
+      break;
+    auto megabytesAcked = static_cast<float>(BytesAcked.load()) / BYTES_IN_MEGABYTE;
+    auto megabitsAcked = megabytesAcked * BITS_IN_BYTE;
+    auto elapsedTime = Time() - TransferTimeStart;
+    auto rate = megabitsAcked / elapsedTime;
+    printf("[%2llu] B %6lld (%5.1f MB) N %6llu T %zu F %zu P %zu E %u W %u S %.3f Mbps RTT %.3f\n", seconds, SenderBase.load(), megabytesAcked, NextSequence.load(), TotalTimeouts.load(), TotalFastRetransmissions.load(), TotalTailProbes.load(), Congestion.GetCeCount(), EffectiveWindow.load(), rate, Estimator.GetEstimatedRtt());
+    if (Io.Spinning())
+    {
+      auto stats = GetLowLatencyStats();
+      printf("     spin %llu hit %llu miss (%.3f s) select %llu (%.3f s) ack thread CPU %.3f s\n", stats.SpinHits, stats.SpinMisses, stats.SpinSeconds, stats.SelectWakeups, stats.SelectSeconds, stats.AckThreadCpuSeconds);
+    }
+    seconds += interval;
+  }
+}
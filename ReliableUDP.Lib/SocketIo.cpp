@@ -0,0 +1,259 @@
+﻿// File: SocketIo.cpp
+// Martin Fracker
+// CSCE 463-500 Spring 2017
+#include "SocketIo.h"
+#include <cstdio>
+#include "SenderSocket.h"
+
+SocketIo::SocketIo()
+{
+  memset(&Remote, 0, sizeof(Remote));
+}
+
+SocketIo::~SocketIo()
+{
+  // registered buffers and queues have to go while the socket and Winsock are still up
+  Rio.Shutdown();
+  if (Socket != INVALID_SOCKET)
+    closesocket(Socket);
+  if (Started)
+    WSACleanup();
+}
+
+void SocketIo::Initialize(bool registeredIo)
+{
+  WSADATA wsaData;
+  WORD wVersionRequested = MAKEWORD(2, 2);
+  if (WSAStartup(wVersionRequested, &wsaData) != 0) {
+    printf("WSAStartup error %d\n", WSAGetLastError());
+    std::exit(EXIT_FAILURE);
+  }
+  Started = true;
+  if (registeredIo)
+    Socket = WSASocket(AF_INET, SOCK_DGRAM, IPPROTO_UDP, nullptr, 0, WSA_FLAG_REGISTERED_IO);
+  if (Socket == INVALID_SOCKET)
+    Socket = socket(AF_INET, SOCK_DGRAM, 0);
+  if (Socket == INVALID_SOCKET) {
+    printf("socket() generated error %d\n", WSAGetLastError());
+    std::exit(EXIT_FAILURE);
+  }
+  struct sockaddr_in local;
+  memset(&local, 0, sizeof(local));
+  local.sin_family = AF_INET;
+  local.sin_port = htons(0);
+  local.sin_addr.s_addr = htonl(INADDR_ANY);
+  if (bind(Socket, (struct sockaddr*)(&local), sizeof(local)) == SOCKET_ERROR) {
+    printf("bind() failed with error %d\n", WSAGetLastError());
+    std::exit(EXIT_FAILURE);
+  }
+  int kernelBuffer = 100e6; //100 meg
+  if (setsockopt(Socket, SOL_SOCKET, SO_RCVBUF, (char*)&kernelBuffer, sizeof(int)) == SOCKET_ERROR) {
+    printf("setsockopt() generated error %d\n", WSAGetLastError());
+    std::exit(EXIT_FAILURE);
+  }
+  kernelBuffer = 100e6; //100 meg
+  if (setsockopt(Socket, SOL_SOCKET, SO_SNDBUF, (char*)&kernelBuffer, sizeof(int)) == SOCKET_ERROR) {
+    printf("setsockopt() generated error %d\n", WSAGetLastError());
+    std::exit(EXIT_FAILURE);
+  }
+
+  LARGE_INTEGER frequency;
+  QueryPerformanceFrequency(&frequency);
+  TicksPerSecond = frequency.QuadPart;
+
+  u_long imode = 1;
+  if (ioctlsocket(Socket, FIONBIO, &imode) == SOCKET_ERROR) {
+    printf("ioctlsocket() generated error %d\n", WSAGetLastError());
+    std::exit(EXIT_FAILURE);
+  }
+  UseRio = registeredIo && Rio.Initialize(Socket);
+  if (registeredIo && !UseRio)
+    printf("registered I/O unavailable, falling back to sendto/recvfrom\n");
+}
+
+bool SocketIo::Connect(const char* host, DWORD port)
+{
+  // structure used in DNS lookups
+  struct hostent* hostname;
+
+  // structure for connecting to server
+  DWORD IP = inet_addr(host);
+  // first assume that the string is an IP address
+  if (IP == INADDR_NONE) {
+    // if not a valid IP, then do a DNS lookup
+    if ((hostname = gethostbyname(host)) == NULL) {
+      return false;
+    }
+    // take the first IP address and copy into sin_addr
+    memcpy((char *)&(Remote.sin_addr), hostname->h_addr, hostname->h_length);
+  } else {
+    // if a valid IP, directly drop its binary version into sin_addr
+    Remote.sin_addr.S_un.S_addr = IP;
+  }
+
+  // setup the port # and protocol type
+  Remote.sin_family = AF_INET;
+  Remote.sin_port = htons(port); // host-to-network flips the byte order
+  return true;
+}
+
+void SocketIo::RegisterRing(char* ring, size_t slotSize, size_t slots)
+{
+  if (UseRio)
+  {
+    Rio.SetRemote(Remote);
+    UseRio = Rio.RegisterRing(ring, slotSize, slots);
+  }
+}
+
+bool SocketIo::Send(const char* slot, size_t length)
+{
+  // registered I/O sends carry no control data, so those datagrams stay Not-ECT
+  if (UseRio)
+    return Rio.Send(slot, length);
+  while(SendDatagram(slot, length) == SOCKET_ERROR)
+  {
+    auto error = WSAGetLastError();
+    if (error == WSAEWOULDBLOCK)
+    {
+      fd_set fds;
+      FD_ZERO(&fds);
+      FD_SET(Socket, &fds);
+      if (select(Socket, nullptr, &fds, nullptr, nullptr) == SOCKET_ERROR)
+      {
+        printf("failed select with error %d\n", error);
+        return false;
+      }
+    } else
+    {
+      printf("failed sendto with error %d\n", error);
+      return false;
+    }
+  }
+  return true;
+}
+
+void SocketIo::Reclaim(const char* slot)
+{
+  if (UseRio)
+    Rio.Reclaim(slot);
+}
+
+int SocketIo::SendDatagram(const char* slot, size_t length)
+{
+  if (!EcnCapable)
+    return sendto(Socket, slot, length, 0, (struct sockaddr*)(&Remote), sizeof(Remote));
+  // mark the datagram ECN-capable so routers can signal congestion before dropping
+  WSABUF data;
+  data.buf = (char*)slot;
+  data.len = static_cast<ULONG>(length);
+  char control[WSA_CMSG_SPACE(sizeof(INT))];
+  memset(control, 0, sizeof(control));
+  WSAMSG msg;
+  msg.name = (struct sockaddr*)(&Remote);
+  msg.namelen = sizeof(Remote);
+  msg.lpBuffers = &data;
+  msg.dwBufferCount = 1;
+  msg.Control.buf = control;
+  msg.Control.len = sizeof(control);
+  msg.dwFlags = 0;
+  auto cmsg = WSA_CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = IPPROTO_IP;
+  cmsg->cmsg_type = IP_ECN;
+  cmsg->cmsg_len = WSA_CMSG_LEN(sizeof(INT));
+  *(INT*)WSA_CMSG_DATA(cmsg) = ECN_ECT0;
+  DWORD sent = 0;
+  return WSASendMsg(Socket, &msg, 0, &sent, nullptr, nullptr);
+}
+
+int SocketIo::Receive(char* packet, size_t packetLength, float seconds)
+{
+  int bytes;
+  auto waitStart = Ticks();
+  auto deadline = waitStart + static_cast<INT64>(seconds * TicksPerSecond);
+  if (SpinTicks > 0)
+  {
+    // the socket is non-blocking, so poll it directly instead of paying for a select() wakeup;
+    // registered I/O completions can even be polled without a system call
+    auto spinEnd = min(waitStart + SpinTicks, deadline);
+    do {
+      bytes = TryReceive(packet, packetLength);
+      if (bytes > 0)
+      {
+        ++SpinHits;
+        SpinTicksUsed += Ticks() - waitStart;
+        return bytes;
+      }
+      if (bytes == SOCKET_ERROR)
+        return SOCKET_ERROR;
+      YieldProcessor();
+    } while (Ticks() < spinEnd);
+    ++SpinMisses;
+    SpinTicksUsed += Ticks() - waitStart;
+  }
+  bytes = WaitReceive(packet, packetLength, max((deadline - Ticks()) * 1000000 / TicksPerSecond, 0LL));
+  if (bytes > 0)
+  {
+    ++SelectWakeups;
+    SelectTicksUsed += Ticks() - waitStart;
+  }
+  return bytes;
+}
+
+int SocketIo::TryReceive(char* packet, size_t packetLength)
+{
+  if (UseRio)
+    return Rio.TryReceive(packet, packetLength);
+  struct sockaddr_in senderAddr;
+  int senderAddrSize = sizeof(senderAddr);
+  int bytes = recvfrom(Socket, packet, packetLength, 0, (struct sockaddr*)(&senderAddr), &senderAddrSize);
+  if (bytes != SOCKET_ERROR)
+    return bytes;
+  if (WSAGetLastError() == WSAEWOULDBLOCK)
+    return 0;
+  printf("failed recvfrom with %d\n", WSAGetLastError());
+  return SOCKET_ERROR;
+}
+
+int SocketIo::WaitReceive(char* packet, size_t packetLength, INT64 micros)
+{
+  // completion event with a timeout stands in for select()
+  if (UseRio)
+    return Rio.Receive(packet, packetLength, micros);
+  fd_set readers;
+  FD_ZERO(&readers);
+  FD_SET(Socket, &readers);
+  struct timeval timeout;
+  timeout.tv_sec = static_cast<long>(micros / 1000000);
+  timeout.tv_usec = static_cast<long>(micros % 1000000);
+  int err = select(Socket, &readers, nullptr, nullptr, &timeout);
+  if (err == SOCKET_ERROR)
+  {
+    printf("failed select with error %d\n", WSAGetLastError());
+    std::exit(EXIT_FAILURE);
+  }
+  if (err == 0)
+    return 0;
+  return TryReceive(packet, packetLength);
+}
+
+void SocketIo::SetSpin(DWORD microseconds)
+{
+  SpinTicks = static_cast<INT64>(microseconds) * TicksPerSecond / 1000000;
+}
+
+void SocketIo::GetStats(LowLatencyStats* stats) const
+{
+  stats->SpinHits = SpinHits;
+  stats->SpinMisses = SpinMisses;
+  stats->SelectWakeups = SelectWakeups;
+  stats->SpinSeconds = static_cast<double>(SpinTicksUsed) / TicksPerSecond;
+  stats->SelectSeconds = static_cast<double>(SelectTicksUsed) / TicksPerSecond;
+}
+
+INT64 SocketIo::Ticks() const
+{
+  LARGE_INTEGER now;
+  QueryPerformanceCounter(&now);
+  return now.QuadPart;
+}
@@ -0,0 +1,79 @@
+﻿// File: SocketIo.h
+// Martin Fracker
+// CSCE 463-500 Spring 2017
+#pragma once
+
+#define _WINSOCK_DEPRECATED_NO_WARNINGS // inet_addr and gethostbyname are deprecated in winsock2
+#include <winsock2.h>
+#include <windows.h>
+#include <atomic>
+#include "RioEngine.h"
+
+struct LowLatencyOptions
+{
+  int Core = -1; // core to pin the ack thread to, -1 leaves it unpinned
+  DWORD SpinMicroseconds = 0; // how long to poll for an ack before blocking in select(), 0 disables
+};
+
+struct LowLatencyStats
+{
+  // acks found while polling, and how long the ack thread spent polling for all of them (hits and misses)
+  UINT64 SpinHits = 0;
+  UINT64 SpinMisses = 0;
+  double SpinSeconds = 0;
+  // acks that needed a select() wakeup, and the total wait for them
+  UINT64 SelectWakeups = 0;
+  double SelectSeconds = 0;
+  double AckThreadCpuSeconds = 0;
+};
+
+// The sender's I/O engine: a non-blocking UDP socket driven through sendto/recvfrom
+// and select(), or through Registered I/O when asked for and the kernel has it.
+// SenderSocket only reaches the network through the members below, so any class
+// with the same members can stand in for it (see SenderPolicies.h).
+class SocketIo
+{
+public:
+  SocketIo();
+  ~SocketIo();
+
+  // creates and binds the socket; exits the process if that fails
+  void Initialize(bool registeredIo);
+  // false if host has no DNS entry
+  bool Connect(const char* host, DWORD port);
+  // packets are only ever sent from this ring; must be called before the first Send
+  void RegisterRing(char* ring, size_t slotSize, size_t slots);
+  // mark outgoing datagrams ECT(0)
+  void SetEcnCapable(bool capable) { EcnCapable = capable; }
+
+  bool Send(const char* slot, size_t length);
+  // waits until slot may be overwritten; sendto copies the datagram, so only
+  // registered I/O ever waits
+  void Reclaim(const char* slot);
+  // waits up to `seconds`; returns the datagram length, 0 on timeout, SOCKET_ERROR on failure
+  int Receive(char* packet, size_t packetLength, float seconds);
+
+  void SetSpin(DWORD microseconds);
+  bool Spinning() const { return SpinTicks > 0; }
+  // fills in everything but the ack thread's CPU time
+  void GetStats(LowLatencyStats* stats) const;
+
+private:
+  SOCKET Socket = INVALID_SOCKET;
+  struct sockaddr_in Remote;
+  RioEngine Rio;
+  bool UseRio = false;
+  bool Started = false; // WSAStartup succeeded
+  std::atomic<bool> EcnCapable = false;
+  INT64 TicksPerSecond = 1;
+  std::atomic<INT64> SpinTicks = 0;
+  std::atomic<UINT64> SpinHits = 0, SpinMisses = 0, SelectWakeups = 0;
+  std::atomic<INT64> SpinTicksUsed = 0, SelectTicksUsed = 0;
+
+  int SendDatagram(const char* slot, size_t length);
+  // the two halves of Receive, each delegating to Rio when registered I/O is on:
+  // a poll that returns 0 if nothing is waiting, and a wait of up to `micros`
+  int TryReceive(char* packet, size_t packetLength);
+  int WaitReceive(char* packet, size_t packetLength, INT64 micros);
+  INT64 Ticks() const;
+};
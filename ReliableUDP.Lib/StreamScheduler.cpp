@@ -0,0 +1,100 @@
+﻿// File: StreamScheduler.cpp
+// Martin Fracker
+// CSCE 463-500 Spring 2017
+#include "StreamScheduler.h"
+#include <cstring>
+
+bool StreamScheduler::AddStream(WORD streamId, int priority, DWORD weight)
+{
+  if (Find(streamId) != nullptr)
+    return false;
+  Stream stream;
+  stream.Id = streamId;
+  stream.Priority = priority;
+  stream.Weight = max(weight, 1);
+  auto position = Streams.begin();
+  while (position != Streams.end() && position->Priority <= priority)
+    ++position;
+  Streams.insert(position, stream);
+  Current = 0;
+  return true;
+}
+
+bool StreamScheduler::Enqueue(WORD streamId, const char* buffer, DWORD bytes)
+{
+  auto stream = Find(streamId);
+  if (stream == nullptr)
+    return false;
+  if (bytes == 0)
+    return true;
+  Chunk chunk;
+  chunk.Buffer = buffer;
+  chunk.Bytes = bytes;
+  stream->Chunks.push_back(chunk);
+  Queued += bytes;
+  return true;
+}
+
+DWORD StreamScheduler::Next(WORD* streamId, DWORD* streamSequence, char* payload, DWORD maxPayload)
+{
+  if (Queued == 0)
+    return 0;
+  // streams are ordered by priority, so the first one with data is the most urgent
+  int priority = 0;
+  for (auto& stream : Streams) {
+    if (!stream.Chunks.empty()) {
+      priority = stream.Priority;
+      break;
+    }
+  }
+  if (Current >= Streams.size() || Streams[Current].Priority != priority) {
+    Current = 0;
+    while (Streams[Current].Priority != priority)
+      ++Current;
+  }
+  while (true) {
+    auto& stream = Streams[Current];
+    if (stream.Priority == priority && !stream.Chunks.empty()) {
+      if (stream.Deficit <= 0)
+        stream.Deficit += static_cast<INT64>(stream.Weight) * maxPayload;
+      auto bytes = Fill(stream, payload, maxPayload);
+      *streamId = stream.Id;
+      *streamSequence = stream.NextSequence++;
+      stream.Deficit -= bytes;
+      // the turn ends once the quantum is spent or the stream runs dry
+      if (stream.Deficit <= 0 || stream.Chunks.empty())
+        Current = (Current + 1) % Streams.size();
+      return bytes;
+    }
+    // idle streams do not bank credit
+    stream.Deficit = 0;
+    Current = (Current + 1) % Streams.size();
+  }
+}
+
+StreamScheduler::Stream* StreamScheduler::Find(WORD streamId)
+{
+  for (auto& stream : Streams)
+    if (stream.Id == streamId)
+      return &stream;
+  return nullptr;
+}
+
+DWORD StreamScheduler::Fill(Stream& stream, char* payload, DWORD maxPayload)
+{
+  DWORD filled = 0;
+  // consecutive small writes share a packet instead of costing one each
+  while (filled < maxPayload && !stream.Chunks.empty()) {
+    auto& chunk = stream.Chunks.front();
+    auto bytes = min(chunk.Bytes - stream.Offset, maxPayload - filled);
+    memcpy(payload + filled, chunk.Buffer + stream.Offset, bytes);
+    filled += bytes;
+    stream.Offset += bytes;
+    if (stream.Offset == chunk.Bytes) {
+      stream.Chunks.pop_front();
+      stream.Offset = 0;
+    }
+  }
+  Queued -= filled;
+  return filled;
+}
@@ -0,0 +1,48 @@
+﻿// File: StreamScheduler.h
+// Martin Fracker
+// CSCE 463-500 Spring 2017
+#pragma once
+
+#define _WINSOCK_DEPRECATED_NO_WARNINGS
+#include <winsock2.h>
+#include <windows.h>
+#include <deque>
+#include <vector>
+
+// Decides which stream fills the next packet. Lower priority values always go
+// first; streams that share a priority split packets in proportion to their
+// weight (deficit round robin with a quantum of weight full packets).
+class StreamScheduler
+{
+public:
+  bool AddStream(WORD streamId, int priority, DWORD weight);
+  // queues the caller's buffer without copying it; it must stay valid until sent
+  bool Enqueue(WORD streamId, const char* buffer, DWORD bytes);
+  // copies up to maxPayload bytes of the chosen stream into payload and returns how many,
+  // or 0 if nothing is queued
+  DWORD Next(WORD* streamId, DWORD* streamSequence, char* payload, DWORD maxPayload);
+  bool Empty() const { return Queued == 0; }
+
+private:
+  struct Chunk
+  {
+    const char* Buffer;
+    DWORD Bytes;
+  };
+  struct Stream
+  {
+    WORD Id;
+    int Priority;
+    DWORD Weight;
+    std::deque<Chunk> Chunks;
+    DWORD Offset = 0; // bytes of the front chunk already sent
+    DWORD NextSequence = 0;
+    INT64 Deficit = 0;
+  };
+  std::vector<Stream> Streams; // ordered by priority
+  size_t Current = 0;
+  UINT64 Queued = 0;
+
+  Stream* Find(WORD streamId);
+  DWORD Fill(Stream& stream, char* payload, DWORD maxPayload);
+};
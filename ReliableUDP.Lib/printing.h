@@ -1,5 +0,0 @@
-﻿// File: printing.h
-// Martin Fracker
-// CSCE 463-500 Spring 2017
-
-void PrintDebug(char* format, ...);
@@ -0,0 +1,123 @@
+﻿// File: CheckpointTest.cpp
+// Martin Fracker
+// CSCE 463-500 Spring 2017
+#include <gtest/gtest.h>
+#include <Checkpoint.h>
+#include <cstdio>
+#include <fstream>
+#include <vector>
+
+static const char* LOG_PATH = "CheckpointTest.log";
+
+class CheckpointTest : public ::testing::Test
+{
+protected:
+  void SetUp() override { std::remove(LOG_PATH); }
+  void TearDown() override { std::remove(LOG_PATH); }
+
+  // logs each (word, bits) pair for transferId and closes the log
+  static void Write(UINT64 transferId, const std::vector<std::pair<UINT64, UINT64>>& records)
+  {
+    Checkpoint log;
+    std::vector<UINT64> ignored;
+    ASSERT_TRUE(log.Open(LOG_PATH, transferId, ignored));
+    for (auto& record : records)
+      log.Record(record.first, record.second);
+    log.Close();
+  }
+  static std::vector<UINT64> Replay(UINT64 transferId)
+  {
+    Checkpoint log;
+    std::vector<UINT64> bitmap;
+    EXPECT_TRUE(log.Open(LOG_PATH, transferId, bitmap));
+    return bitmap;
+  }
+  static size_t LogSize()
+  {
+    std::ifstream file(LOG_PATH, std::ios::binary | std::ios::ate);
+    return static_cast<size_t>(file.tellg());
+  }
+  static void Append(const char* bytes, size_t length)
+  {
+    std::ofstream file(LOG_PATH, std::ios::binary | std::ios::app);
+    file.write(bytes, length);
+  }
+};
+
+TEST_F(CheckpointTest, NewLogIsEmpty)
+{
+  EXPECT_TRUE(Replay(1).empty());
+  EXPECT_EQ(0u, LogSize());
+}
+
+TEST_F(CheckpointTest, ReplaysValidLog)
+{
+  Write(7, { { 0, ~0ULL }, { 2, 0x5 }, { 2, 0x8 } });
+  auto bitmap = Replay(7);
+  ASSERT_EQ(3u, bitmap.size());
+  EXPECT_EQ(~0ULL, bitmap[0]);
+  EXPECT_EQ(0u, bitmap[1]);
+  // records of the same word accumulate
+  EXPECT_EQ(0xDu, bitmap[2]);
+}
+
+TEST_F(CheckpointTest, NothingIsWrittenBeforeFlush)
+{
+  Checkpoint log;
+  std::vector<UINT64> bitmap;
+  ASSERT_TRUE(log.Open(LOG_PATH, 7, bitmap));
+  log.Record(0, 1);
+  EXPECT_EQ(0u, LogSize());
+  log.Flush();
+  EXPECT_EQ(sizeof(CheckpointRecord), LogSize());
+}
+
+TEST_F(CheckpointTest, TornTailIsCutBeforeAppending)
+{
+  Write(7, { { 0, 0x1 }, { 1, 0x2 } });
+  // half a record, as left by a crash in the middle of a write
+  CheckpointRecord torn = {};
+  torn.TransferId = 7;
+  torn.Word = 3;
+  torn.Bits = ~0ULL;
+  Append((const char*)(&torn), sizeof(torn) / 2);
+  Write(7, { { 4, 0x10 } });
+  EXPECT_EQ(3 * sizeof(CheckpointRecord), LogSize());
+  auto bitmap = Replay(7);
+  ASSERT_EQ(5u, bitmap.size());
+  EXPECT_EQ(0x1u, bitmap[0]);
+  EXPECT_EQ(0x2u, bitmap[1]);
+  EXPECT_EQ(0u, bitmap[3]);
+  EXPECT_EQ(0x10u, bitmap[4]);
+}
+
+TEST_F(CheckpointTest, BadCrcEndsReplay)
+{
+  Write(7, { { 0, 0x1 } });
+  CheckpointRecord bad = {};
+  bad.TransferId = 7;
+  bad.Word = 1;
+  bad.Bits = 0x3;
+  bad.Crc = 0xDEADBEEF;
+  Append((const char*)(&bad), sizeof(bad));
+  auto bitmap = Replay(7);
+  ASSERT_EQ(1u, bitmap.size());
+  EXPECT_EQ(sizeof(CheckpointRecord), LogSize());
+}
+
+TEST_F(CheckpointTest, OtherTransfersAreSkipped)
+{
+  Write(1, { { 0, 0x1 }, { 1, 0x1 } });
+  Write(2, { { 0, 0x2 }, { 5, 0x2 } });
+  Write(1, { { 0, 0x4 } });
+  auto first = Replay(1);
+  ASSERT_EQ(2u, first.size());
+  EXPECT_EQ(0x5u, first[0]);
+  EXPECT_EQ(0x1u, first[1]);
+  auto second = Replay(2);
+  ASSERT_EQ(6u, second.size());
+  EXPECT_EQ(0x2u, second[0]);
+  EXPECT_EQ(0x2u, second[5]);
+  EXPECT_TRUE(Replay(3).empty());
+  EXPECT_EQ(5 * sizeof(CheckpointRecord), LogSize());
+}
@@ -0,0 +1,76 @@
+﻿// File: ChecksumTest.cpp
+// Martin Fracker
+// CSCE 463-500 Spring 2017
+#include <gtest/gtest.h>
+#include <Checksum.h>
+#include <Delta.h>
+#include <random>
+#include <vector>
+
+// one byte at a time, straight from the polynomial
+static DWORD BytewiseCrc32(const UCHAR* buf, size_t len)
+{
+  DWORD c = 0xFFFFFFFF;
+  for (size_t i = 0; i < len; ++i) {
+    c ^= buf[i];
+    for (int bit = 0; bit < 8; ++bit)
+      c = (c & 1) ? (0xEDB88320 ^ (c >> 1)) : (c >> 1);
+  }
+  return c ^ 0xFFFFFFFF;
+}
+
+static std::vector<UCHAR> RandomBytes(size_t length, unsigned seed)
+{
+  std::mt19937 generator(seed);
+  std::vector<UCHAR> bytes(length);
+  for (auto& byte : bytes)
+    byte = static_cast<UCHAR>(generator());
+  return bytes;
+}
+
+TEST(ChecksumTest, KnownValue)
+{
+  Checksum crc;
+  EXPECT_EQ(0xCBF43926u, crc.CRC32((const UCHAR*)"123456789", 9));
+  EXPECT_EQ(0u, crc.CRC32(nullptr, 0));
+}
+
+TEST(ChecksumTest, SlicingMatchesBytewise)
+{
+  Checksum crc;
+  auto bytes = RandomBytes(4096 + 7, 1);
+  // every length mod 8 and every alignment of the first byte
+  for (size_t offset = 0; offset < 8; ++offset)
+    for (size_t length = 0; length < 64; ++length)
+      ASSERT_EQ(BytewiseCrc32(bytes.data() + offset, length), crc.CRC32(bytes.data() + offset, length)) << offset << " " << length;
+  EXPECT_EQ(BytewiseCrc32(bytes.data(), bytes.size()), crc.CRC32(bytes.data(), bytes.size()));
+}
+
+TEST(RollingChecksumTest, RollMatchesRecompute)
+{
+  auto bytes = RandomBytes(2048, 2);
+  const DWORD window = 700;
+  RollingChecksum rolling;
+  rolling.Reset(bytes.data(), window);
+  for (size_t start = 1; start + window <= bytes.size(); ++start) {
+    rolling.Roll(bytes[start - 1], bytes[start - 1 + window]);
+    RollingChecksum fresh;
+    fresh.Reset(bytes.data() + start, window);
+    ASSERT_EQ(fresh.Value(), rolling.Value()) << start;
+  }
+}
+
+TEST(RollingChecksumTest, RollSurvivesWraparound)
+{
+  // all 0xFF makes both sums pass 2^16 many times over
+  std::vector<UCHAR> bytes(70000, 0xFF);
+  bytes[69999] = 0;
+  const DWORD window = 65536;
+  RollingChecksum rolling;
+  rolling.Reset(bytes.data(), window);
+  for (size_t start = 1; start + window <= bytes.size(); ++start)
+    rolling.Roll(bytes[start - 1], bytes[start - 1 + window]);
+  RollingChecksum fresh;
+  fresh.Reset(bytes.data() + bytes.size() - window, window);
+  EXPECT_EQ(fresh.Value(), rolling.Value());
+}
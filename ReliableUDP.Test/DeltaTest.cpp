@@ -0,0 +1,114 @@
+﻿// File: DeltaTest.cpp
+// Martin Fracker
+// CSCE 463-500 Spring 2017
+#include <gtest/gtest.h>
+#include <Delta.h>
+#include <cstring>
+#include <random>
+#include <vector>
+
+static const DWORD BLOCK = 64;
+
+class DeltaTest : public ::testing::Test
+{
+protected:
+  std::vector<char> Basis;
+  DeltaSignature Signature;
+
+  void SetUp() override
+  {
+    Basis = Random(BLOCK * 100 + 13, 1);
+    Signature.Build(Basis.data(), Basis.size(), BLOCK);
+  }
+  static std::vector<char> Random(size_t length, unsigned seed)
+  {
+    std::mt19937 generator(seed);
+    std::vector<char> bytes(length);
+    for (auto& byte : bytes)
+      byte = static_cast<char>(generator());
+    return bytes;
+  }
+  // encodes target against the basis, checks it decodes back and returns the delta size
+  size_t RoundTrip(const std::vector<char>& target, unsigned threads = 1)
+  {
+    std::vector<char> delta;
+    DeltaEncoder::Encode(Signature, target.data(), target.size(), &delta, threads);
+    std::vector<char> rebuilt;
+    EXPECT_TRUE(DeltaDecoder::Apply(Basis.data(), Basis.size(), delta.data(), delta.size(), &rebuilt, threads));
+    EXPECT_EQ(target, rebuilt);
+    return delta.size();
+  }
+};
+
+TEST_F(DeltaTest, IdenticalIsAllCopies)
+{
+  auto size = RoundTrip(Basis);
+  // one copy op for the 100 whole blocks, one literal for the 13 byte tail
+  EXPECT_EQ(sizeof(DeltaHeader) + 2 * sizeof(DeltaOp) + 13, size);
+}
+
+TEST_F(DeltaTest, ShiftedStillMatches)
+{
+  std::vector<char> target(Basis);
+  target.insert(target.begin(), { 'x', 'y', 'z' });
+  auto size = RoundTrip(target);
+  EXPECT_LT(size, Basis.size() / 4);
+}
+
+TEST_F(DeltaTest, EditInTheMiddle)
+{
+  std::vector<char> target(Basis);
+  target[BLOCK * 50 + 5] ^= 0x55;
+  auto size = RoundTrip(target);
+  EXPECT_LT(size, Basis.size() / 4);
+}
+
+TEST_F(DeltaTest, DifferentIsAllLiteral)
+{
+  auto target = Random(Basis.size(), 2);
+  EXPECT_EQ(sizeof(DeltaHeader) + sizeof(DeltaOp) + target.size(), RoundTrip(target));
+}
+
+TEST_F(DeltaTest, EmptyAndShortTargets)
+{
+  RoundTrip(std::vector<char>());
+  RoundTrip(std::vector<char>(Basis.begin(), Basis.begin() + BLOCK - 1));
+}
+
+TEST_F(DeltaTest, SegmentsDecodeLikeOneDelta)
+{
+  std::vector<char> target(Basis);
+  target.insert(target.begin() + 1000, 17, 'q');
+  // segments that cut through blocks and matches alike
+  for (UINT64 segment : { 1ULL, 37ULL, static_cast<UINT64>(BLOCK), 1000ULL }) {
+    DeltaEncoder encoder(Signature, target.data(), target.size(), 1);
+    std::vector<char> delta;
+    while (!encoder.Done())
+      encoder.Next(segment, &delta);
+    std::vector<char> rebuilt;
+    ASSERT_TRUE(DeltaDecoder::Apply(Basis.data(), Basis.size(), delta.data(), delta.size(), &rebuilt)) << segment;
+    EXPECT_EQ(target, rebuilt) << segment;
+  }
+}
+
+TEST_F(DeltaTest, MalformedDeltaIsRejected)
+{
+  std::vector<char> delta;
+  DeltaEncoder::Encode(Signature, Basis.data(), Basis.size(), &delta, 1);
+  std::vector<char> rebuilt;
+  EXPECT_FALSE(DeltaDecoder::Apply(Basis.data(), Basis.size(), delta.data(), delta.size() - 1, &rebuilt));
+  EXPECT_FALSE(DeltaDecoder::Apply(Basis.data(), Basis.size() / 2, delta.data(), delta.size(), &rebuilt));
+  delta[0] ^= 1;
+  EXPECT_FALSE(DeltaDecoder::Apply(Basis.data(), Basis.size(), delta.data(), delta.size(), &rebuilt));
+}
+
+TEST_F(DeltaTest, ThreadsAgreeWithOneThread)
+{
+  // big enough to be split between threads
+  Basis = Random(3 * DELTA_MIN_SPLIT + 5, 3);
+  Signature.Build(Basis.data(), Basis.size(), 4096, 4);
+  std::vector<char> target(Basis);
+  target.erase(target.begin() + DELTA_MIN_SPLIT, target.begin() + DELTA_MIN_SPLIT + 100);
+  target[2 * DELTA_MIN_SPLIT] ^= 1;
+  EXPECT_LT(RoundTrip(target, 4), target.size() / 100);
+}
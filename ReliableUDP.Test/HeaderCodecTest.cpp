@@ -0,0 +1,125 @@
+﻿// File: HeaderCodecTest.cpp
+// Martin Fracker
+// CSCE 463-500 Spring 2017
+#include <gtest/gtest.h>
+#include <HeaderCodec.h>
+#include <cstring>
+
+static const UINT64 TWO_32 = 1ULL << 32;
+
+TEST(HeaderCodecTest, SequenceBytesBoundaries)
+{
+  // b bytes serve windows w with 2^(8b - 1) > V2_SEQUENCE_MARGIN * (w + 1)
+  EXPECT_EQ(1u, HeaderCodec::SequenceBytes(0));
+  EXPECT_EQ(1u, HeaderCodec::SequenceBytes(6));
+  EXPECT_EQ(2u, HeaderCodec::SequenceBytes(7));
+  EXPECT_EQ(2u, HeaderCodec::SequenceBytes(2046));
+  EXPECT_EQ(3u, HeaderCodec::SequenceBytes(2047));
+  EXPECT_EQ(3u, HeaderCodec::SequenceBytes(524286));
+  EXPECT_EQ(4u, HeaderCodec::SequenceBytes(524287));
+  EXPECT_EQ(4u, HeaderCodec::SequenceBytes(MAXDWORD));
+  EXPECT_EQ(4u, HeaderCodec::SequenceBytes(MAXUINT64 / 32));
+}
+
+TEST(HeaderCodecTest, ExpandAcross2To32)
+{
+  // base just above 2^32: small truncated values are ahead of it, large ones just behind
+  EXPECT_EQ(TWO_32 + 3, HeaderCodec::Expand(3, 4, TWO_32 + 5));
+  EXPECT_EQ(TWO_32 + 9, HeaderCodec::Expand(9, 4, TWO_32 + 5));
+  EXPECT_EQ(TWO_32 - 2, HeaderCodec::Expand(0xFFFFFFFE, 4, TWO_32 + 5));
+  // base just below 2^32: large values stay below it and small ones carry over
+  EXPECT_EQ(TWO_32 - 16, HeaderCodec::Expand(0xFFFFFFF0, 4, TWO_32 - 3));
+  EXPECT_EQ(TWO_32 - 1, HeaderCodec::Expand(0xFFFFFFFF, 4, TWO_32 - 3));
+  EXPECT_EQ(TWO_32 + 2, HeaderCodec::Expand(2, 4, TWO_32 - 3));
+  // exactly at 2^32
+  EXPECT_EQ(TWO_32, HeaderCodec::Expand(0, 4, TWO_32));
+  EXPECT_EQ(TWO_32 - 1, HeaderCodec::Expand(0xFFFFFFFF, 4, TWO_32));
+}
+
+TEST(HeaderCodecTest, ExpandSmallWidths)
+{
+  // one byte around 256: ties half a range away resolve ahead of the base
+  EXPECT_EQ(256u + 2, HeaderCodec::Expand(2, 1, 250));
+  EXPECT_EQ(250u, HeaderCodec::Expand(250, 1, 260));
+  EXPECT_EQ(328u, HeaderCodec::Expand(72, 1, 200));
+  EXPECT_EQ(73u, HeaderCodec::Expand(73, 1, 200));
+  // two and three bytes across their own wraps
+  EXPECT_EQ(0x10001u, HeaderCodec::Expand(0x0001, 2, 0xFFF0));
+  EXPECT_EQ(0xFFFFu, HeaderCodec::Expand(0xFFFF, 2, 0x10004));
+  EXPECT_EQ(0x1000000u + 7, HeaderCodec::Expand(7, 3, 0xFFFFFE));
+}
+
+TEST(HeaderCodecTest, ExpandAtTheEnds)
+{
+  // nothing lies below zero or above the top of the 64-bit space
+  EXPECT_EQ(0xFFFFFFFFu, HeaderCodec::Expand(0xFFFFFFFF, 4, 0));
+  EXPECT_EQ(0xF0u, HeaderCodec::Expand(0xF0, 1, 3));
+  EXPECT_EQ(0xFFFFFFFFFFFFFF05ULL, HeaderCodec::Expand(0x05, 1, MAXUINT64 - 1));
+  EXPECT_EQ(MAXUINT64, HeaderCodec::Expand(0xFF, 1, MAXUINT64 - 1));
+}
+
+TEST(HeaderCodecTest, RoundTripAroundWraps)
+{
+  char header[V2_MAX_FIXED_HEADER];
+  for (UINT64 window : { 6ULL, 100ULL, 2046ULL, 100000ULL }) {
+    auto bytes = HeaderCodec::SequenceBytes(window);
+    for (UINT64 wrap : { 1ULL << (8 * bytes), TWO_32 }) {
+      for (UINT64 sequence = wrap - window - 2; sequence < wrap + window + 2; sequence += 1 + window / 50) {
+        // the receiver's ack may trail the packet by up to a window, or lead a stale one
+        for (UINT64 ack : { sequence - window, sequence, sequence + window }) {
+          auto length = HeaderCodec::Encode(header, sequence, bytes, false);
+          UINT64 decoded;
+          bool stream;
+          size_t headerLength;
+          ASSERT_TRUE(HeaderCodec::Decode(header, length, ack, &decoded, &stream, &headerLength));
+          ASSERT_EQ(sequence, decoded) << "window " << window << " ack " << ack;
+          ASSERT_EQ(length, headerLength);
+        }
+      }
+    }
+  }
+}
+
+TEST(HeaderCodecTest, ExtensionsAndFlags)
+{
+  char extensions[16];
+  DWORD stamp = 0x01020304;
+  auto extensionsLength = HeaderCodec::AppendExtension(extensions, EXT_TIMESTAMP, &stamp, sizeof(stamp));
+  char header[32];
+  auto length = HeaderCodec::Encode(header, 77, 2, true, extensions, extensionsLength);
+  memcpy(header + length, "payload", 7);
+  UINT64 sequence;
+  bool stream;
+  size_t headerLength;
+  const char* found;
+  size_t foundLength;
+  ASSERT_TRUE(HeaderCodec::Decode(header, length + 7, 70, &sequence, &stream, &headerLength, &found, &foundLength));
+  EXPECT_EQ(77u, sequence);
+  EXPECT_TRUE(stream);
+  EXPECT_EQ(length, headerLength);
+  BYTE type;
+  const char* value;
+  BYTE valueLength;
+  ASSERT_TRUE(HeaderCodec::NextExtension(&found, &type, &value, &valueLength));
+  EXPECT_EQ(EXT_TIMESTAMP, type);
+  ASSERT_EQ(sizeof(stamp), valueLength);
+  EXPECT_EQ(0, memcmp(value, &stamp, sizeof(stamp)));
+  EXPECT_FALSE(HeaderCodec::NextExtension(&found, &type, &value, &valueLength));
+}
+
+TEST(HeaderCodecTest, RejectsMalformed)
+{
+  UINT64 sequence;
+  bool stream;
+  size_t headerLength;
+  char v1[] = { 0x00, 0x01, 0x02 };
+  EXPECT_FALSE(HeaderCodec::Decode(v1, sizeof(v1), 0, &sequence, &stream, &headerLength));
+  char reserved[] = { static_cast<char>(V2_MARKER | 0x80), 0x01 };
+  EXPECT_FALSE(HeaderCodec::Decode(reserved, sizeof(reserved), 0, &sequence, &stream, &headerLength));
+  char header[V2_MAX_FIXED_HEADER];
+  auto length = HeaderCodec::Encode(header, 5, 4, false);
+  EXPECT_FALSE(HeaderCodec::Decode(header, length - 1, 0, &sequence, &stream, &headerLength));
+  // extensions promised but never closed
+  header[0] |= V2_EXTENSIONS;
+  EXPECT_FALSE(HeaderCodec::Decode(header, length, 0, &sequence, &stream, &headerLength));
+}
@@ -0,0 +1,92 @@
+﻿// File: LoopbackIo.cpp
+// Martin Fracker
+// CSCE 463-500 Spring 2017
+#include "LoopbackIo.h"
+#include <SenderSocket.inl>
+#include <cstdarg>
+#include <cstdio>
+
+bool LoopbackIo::Send(const char* slot, size_t length)
+{
+  if (length < sizeof(SenderDataHeader))
+    return false;
+  SenderDataHeader header;
+  memcpy(&header, slot, sizeof(header));
+  // answer the way ReceiverSocket would
+  ReceiverHeader reply;
+  reply.Flags.Ack = 1;
+  reply.ReceiverWindow = LOOPBACK_WINDOW;
+  std::lock_guard<std::mutex> lock(Lock);
+  if (header.Flags.Syn) {
+    reply.Flags.Syn = 1;
+    reply.AckSequence = 0;
+    NextSequence = 0;
+    Early.clear();
+    Attempts.clear();
+  } else if (header.Flags.Fin) {
+    // the FIN is only acked once everything before it is in
+    reply.Flags.Fin = header.Sequence == static_cast<DWORD>(NextSequence);
+    reply.AckSequence = static_cast<DWORD>(NextSequence);
+  } else {
+    auto attempt = ++Attempts[header.Sequence];
+    if (Drop && Drop(header.Sequence, attempt))
+      return true;
+    ++PacketsReceived;
+    if (header.Sequence > NextSequence)
+      Early.insert(header.Sequence);
+    else if (header.Sequence == NextSequence)
+      ++NextSequence;
+    while (!Early.empty() && *Early.begin() <= NextSequence) {
+      if (*Early.begin() == NextSequence)
+        ++NextSequence;
+      Early.erase(Early.begin());
+    }
+    reply.AckSequence = static_cast<DWORD>(NextSequence);
+  }
+  Replies.push_back({ reply, std::chrono::steady_clock::now() + Delay });
+  Ready.notify_one();
+  return true;
+}
+
+int LoopbackIo::Receive(char* packet, size_t packetLength, float seconds)
+{
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<float>(seconds));
+  std::unique_lock<std::mutex> lock(Lock);
+  // replies are due in the order they were sent
+  while (Replies.empty() || Replies.front().Due > std::chrono::steady_clock::now()) {
+    auto until = Replies.empty() ? deadline : min(deadline, Replies.front().Due);
+    if (Ready.wait_until(lock, until) == std::cv_status::timeout && until == deadline)
+      return 0;
+  }
+  auto bytes = min(sizeof(ReceiverHeader), packetLength);
+  memcpy(packet, &Replies.front().Header, bytes);
+  Replies.pop_front();
+  return static_cast<int>(bytes);
+}
+
+void LoopbackIo::SetDropHook(DropHook hook)
+{
+  std::lock_guard<std::mutex> lock(Lock);
+  Drop = hook;
+}
+
+size_t LoopbackIo::GetAttempts(UINT64 sequence)
+{
+  std::lock_guard<std::mutex> lock(Lock);
+  auto attempts = Attempts.find(sequence);
+  return (attempts == Attempts.end()) ? 0 : attempts->second;
+}
+
+void LegacyTrace(const char* format, ...)
+{
+#if _DEBUG
+  va_list args;
+  va_start(args, format);
+  vprintf(format, args);
+  va_end(args);
+#endif
+}
+
+// the library only instantiates the policy sets it ships
+template class BasicSenderSocket<LoopbackSenderPolicies>;
+template class BasicSenderSocket<LegacyLoopbackSenderPolicies>;
@@ -0,0 +1,102 @@
+﻿// File: LoopbackIo.h
+// Martin Fracker
+// CSCE 463-500 Spring 2017
+#pragma once
+
+#define _WINSOCK_DEPRECATED_NO_WARNINGS
+#include <winsock2.h>
+#include <windows.h>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <set>
+#include <SenderSocket.h>
+
+#define LOOPBACK_WINDOW 0x100000 // window the loopback receiver advertises (in packets)
+
+// An IoEngine whose receiver lives in the same process and acks every datagram as it is
+// sent, by default without delay and, unless a drop hook says otherwise, without loss.
+// What is left is the sender's own cost per packet.
+class LoopbackIo
+{
+public:
+  // true if this send of the data packet is lost; attempt counts from 1
+  typedef std::function<bool(UINT64 sequence, size_t attempt)> DropHook;
+
+  void Initialize(bool) {}
+  bool Connect(const char*, DWORD) { return true; }
+  void RegisterRing(char*, size_t, size_t) {}
+  void SetEcnCapable(bool) {}
+
+  bool Send(const char* slot, size_t length);
+  void Reclaim(const char*) {}
+  int Receive(char* packet, size_t packetLength, float seconds);
+
+  void SetSpin(DWORD) {}
+  bool Spinning() const { return false; }
+  void GetStats(LowLatencyStats*) const {}
+
+  void SetDropHook(DropHook hook);
+  // holds every reply back this long, as a link would; 0 hands it over at once
+  void SetDelay(DWORD microseconds) { Delay = std::chrono::microseconds(microseconds); }
+  // data packets received, retransmissions included
+  UINT64 GetPacketsReceived() const { return PacketsReceived; }
+  // times the data packet was sent, dropped ones included
+  size_t GetAttempts(UINT64 sequence);
+
+private:
+  std::mutex Lock;
+  std::condition_variable Ready;
+  struct Reply
+  {
+    ReceiverHeader Header;
+    std::chrono::steady_clock::time_point Due;
+  };
+  std::deque<Reply> Replies;
+  std::chrono::microseconds Delay = std::chrono::microseconds(0);
+  UINT64 NextSequence = 0;
+  std::set<UINT64> Early; // arrived past a hole
+  UINT64 PacketsReceived = 0;
+  DropHook Drop;
+  std::map<UINT64, size_t> Attempts;
+};
+
+// The old sender's tracing: a call into another translation unit for every packet,
+// with the timestamp read first whether or not anything is printed. Only there to
+// measure the policy build against (see SenderSocketBenchmark.cpp).
+void LegacyTrace(const char* format, ...);
+
+class LegacyTracer
+{
+public:
+  template <class Clock> void Sent(const Clock& clock, const char* packetType, UINT64 sequence, size_t attempt, size_t maximumAttempts, float rto)
+  {
+    LegacyTrace("[%6.3f] --> ", clock.Seconds());
+    LegacyTrace("%s %llu (attempt %zu of %zu, Rto %.3f)\n", packetType, sequence, attempt, maximumAttempts, rto);
+  }
+  template <class Clock> void Acked(const Clock& clock, const char* packetType, DWORD ack, DWORD window)
+  {
+    LegacyTrace("[%6.3f] <-- ", clock.Seconds());
+    LegacyTrace("%s %d window %X", packetType, ack, window);
+  }
+  template <class Clock> void Connected(const Clock& clock, DWORD ack, DWORD window, float rto)
+  {
+    LegacyTrace("[%6.3f] <-- SYN-ACK %lu window %lX; setting initial RTO to %.3f\n", clock.Seconds(), ack, window, rto);
+  }
+};
+
+// the release sender over the loopback
+struct LoopbackSenderPolicies : DefaultSenderPolicies
+{
+  typedef LoopbackIo IoEngine;
+  typedef NullTracer Tracer;
+};
+
+// the same with the old sender's tracing
+struct LegacyLoopbackSenderPolicies : LoopbackSenderPolicies
+{
+  typedef LegacyTracer Tracer;
+};
@@ -0,0 +1,134 @@
+﻿// File: PacketPlacerTest.cpp
+// Martin Fracker
+// CSCE 463-500 Spring 2017
+#include <gtest/gtest.h>
+#include <PacketPlacer.h>
+#include <string>
+
+static const size_t SLOT = 4;
+
+class PacketPlacerTest : public ::testing::Test
+{
+protected:
+  std::vector<char> Buffer;
+  PacketPlacer Placer;
+
+  void Open(UINT64 packets)
+  {
+    Buffer.assign(static_cast<size_t>(packets * SLOT), '.');
+    Placer.Reset(Buffer.data(), Buffer.size(), SLOT);
+  }
+  bool Place(UINT64 sequence, UINT64 window = 1000)
+  {
+    std::string payload(SLOT, static_cast<char>('a' + sequence % 26));
+    return Placer.Place(sequence, payload.data(), payload.size(), window);
+  }
+};
+
+TEST(PacketPlacerBits, LowestSetBit)
+{
+  EXPECT_EQ(0u, PacketPlacer::LowestSetBit(1));
+  EXPECT_EQ(5u, PacketPlacer::LowestSetBit(0x60));
+  EXPECT_EQ(31u, PacketPlacer::LowestSetBit(0x80000000ULL));
+  EXPECT_EQ(32u, PacketPlacer::LowestSetBit(0x100000000ULL));
+  EXPECT_EQ(63u, PacketPlacer::LowestSetBit(0x8000000000000000ULL));
+}
+
+TEST(PacketPlacerBits, HighestSetBit)
+{
+  EXPECT_EQ(0u, PacketPlacer::HighestSetBit(1));
+  EXPECT_EQ(6u, PacketPlacer::HighestSetBit(0x60));
+  EXPECT_EQ(32u, PacketPlacer::HighestSetBit(0x1FFFFFFFFULL));
+  EXPECT_EQ(63u, PacketPlacer::HighestSetBit(~0ULL));
+}
+
+TEST_F(PacketPlacerTest, InOrderAdvancesAck)
+{
+  Open(3);
+  ASSERT_TRUE(Place(0));
+  EXPECT_EQ(1u, Placer.GetAckSequence());
+  ASSERT_TRUE(Place(1));
+  ASSERT_TRUE(Place(2));
+  EXPECT_EQ(3u, Placer.GetAckSequence());
+  EXPECT_EQ("aaaabbbbcccc", std::string(Buffer.begin(), Buffer.end()));
+}
+
+TEST_F(PacketPlacerTest, OutOfOrderLandsInItsSlot)
+{
+  Open(4);
+  ASSERT_TRUE(Place(2));
+  ASSERT_TRUE(Place(3));
+  EXPECT_EQ(0u, Placer.GetAckSequence());
+  EXPECT_EQ("........ccccdddd", std::string(Buffer.begin(), Buffer.end()));
+  ASSERT_TRUE(Place(1));
+  EXPECT_EQ(0u, Placer.GetAckSequence());
+  // filling the hole jumps the ack over everything that arrived early
+  ASSERT_TRUE(Place(0));
+  EXPECT_EQ(4u, Placer.GetAckSequence());
+  EXPECT_EQ("aaaabbbbccccdddd", std::string(Buffer.begin(), Buffer.end()));
+  EXPECT_EQ(Buffer.size(), Placer.GetBytesPlaced());
+}
+
+TEST_F(PacketPlacerTest, AckCrossesWordBoundaries)
+{
+  Open(200);
+  for (UINT64 sequence = 1; sequence < 150; ++sequence)
+    ASSERT_TRUE(Place(sequence));
+  EXPECT_EQ(0u, Placer.GetAckSequence());
+  ASSERT_TRUE(Place(0));
+  EXPECT_EQ(150u, Placer.GetAckSequence());
+  for (UINT64 sequence = 151; sequence < 200; ++sequence)
+    ASSERT_TRUE(Place(sequence));
+  ASSERT_TRUE(Place(150));
+  EXPECT_EQ(200u, Placer.GetAckSequence());
+}
+
+TEST_F(PacketPlacerTest, RejectsDuplicates)
+{
+  Open(2);
+  ASSERT_TRUE(Place(1));
+  EXPECT_FALSE(Place(1));
+}
+
+TEST_F(PacketPlacerTest, RejectsOutsideWindowAndBuffer)
+{
+  Open(10);
+  EXPECT_FALSE(Place(4, 4));
+  EXPECT_TRUE(Place(3, 4));
+  EXPECT_FALSE(Place(10));
+  EXPECT_FALSE(Placer.Place(0, "toolong", 7, 10));
+}
+
+TEST_F(PacketPlacerTest, ShortFinalPacket)
+{
+  Buffer.assign(6, '.');
+  Placer.Reset(Buffer.data(), Buffer.size(), SLOT);
+  EXPECT_EQ(2u, Placer.GetPackets());
+  EXPECT_FALSE(Placer.Place(1, "xyz", 3, 10));
+  ASSERT_TRUE(Placer.Place(1, "xy", 2, 10));
+  EXPECT_EQ(6u, Placer.GetBytesPlaced());
+  EXPECT_EQ(0u, Placer.GetContiguousBytes());
+  ASSERT_TRUE(Placer.Place(0, "abcd", 4, 10));
+  EXPECT_EQ(6u, Placer.GetContiguousBytes());
+}
+
+TEST_F(PacketPlacerTest, ContiguousBytesStopAtTheFirstHole)
+{
+  Open(4);
+  ASSERT_TRUE(Place(0));
+  ASSERT_TRUE(Place(2));
+  EXPECT_EQ(3 * SLOT, Placer.GetBytesPlaced());
+  EXPECT_EQ(SLOT, Placer.GetContiguousBytes());
+}
+
+TEST_F(PacketPlacerTest, RestoreFromWords)
+{
+  Open(130);
+  Placer.Words()[0] = ~0ULL;
+  Placer.Words()[1] = 0x5;
+  Placer.Restore();
+  EXPECT_EQ(65u, Placer.GetAckSequence());
+  EXPECT_EQ(67u * SLOT, Placer.GetBytesPlaced());
+  EXPECT_TRUE(Placer.Arrived(66));
+  EXPECT_FALSE(Placer.Arrived(65));
+}
@@ -0,0 +1,59 @@
+﻿// File: SenderPoliciesTest.cpp
+// Martin Fracker
+// CSCE 463-500 Spring 2017
+#include <gtest/gtest.h>
+#include <SenderPolicies.h>
+
+TEST(EcnCongestionControl, StartsAtTheMaximum)
+{
+  EcnCongestionControl congestion;
+  congestion.Reset(16);
+  EXPECT_FLOAT_EQ(16.f, congestion.GetWindow());
+  EXPECT_EQ(0u, congestion.GetCeCount());
+}
+
+TEST(EcnCongestionControl, HalvesOncePerWindow)
+{
+  EcnCongestionControl congestion;
+  congestion.Reset(16);
+  // packets 0..15 in flight when the first mark is echoed
+  congestion.OnAck(1, 1, 1, 15);
+  EXPECT_FLOAT_EQ(8.f, congestion.GetWindow());
+  EXPECT_EQ(1u, congestion.GetCeCount());
+  // more marks from the same window are not a new congestion event
+  congestion.OnAck(2, 1, 2, 17);
+  congestion.OnAck(3, 1, 15, 20);
+  EXPECT_FLOAT_EQ(8.f, congestion.GetWindow());
+  EXPECT_EQ(3u, congestion.GetCeCount());
+  // once the base passes the recovery point a mark halves again
+  congestion.OnAck(4, 1, 16, 23);
+  EXPECT_FLOAT_EQ(4.f, congestion.GetWindow());
+}
+
+TEST(EcnCongestionControl, NeverBelowOnePacket)
+{
+  EcnCongestionControl congestion;
+  congestion.Reset(4);
+  UINT64 lastSent = 0;
+  for (DWORD ce = 1; ce <= 5; ++ce) {
+    congestion.OnAck(ce, 1, static_cast<INT64>(lastSent + 1), lastSent + 1);
+    lastSent += 2;
+  }
+  EXPECT_FLOAT_EQ(1.f, congestion.GetWindow());
+}
+
+TEST(EcnCongestionControl, GrowsByAPacketPerWindowUpToTheMaximum)
+{
+  EcnCongestionControl congestion;
+  congestion.Reset(10);
+  congestion.OnAck(1, 1, 1, 9);
+  ASSERT_FLOAT_EQ(5.f, congestion.GetWindow());
+  // a full window of acks without marks adds about one packet
+  for (INT64 base = 2; base <= 6; ++base)
+    congestion.OnAck(1, 1, base, 14);
+  EXPECT_GT(congestion.GetWindow(), 5.8f);
+  EXPECT_LT(congestion.GetWindow(), 6.f);
+  for (INT64 base = 7; base < 200; ++base)
+    congestion.OnAck(1, 1, base, base + 10);
+  EXPECT_FLOAT_EQ(10.f, congestion.GetWindow());
+}
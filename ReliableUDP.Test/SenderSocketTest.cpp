@@ -0,0 +1,110 @@
+﻿// File: SenderSocketTest.cpp
+// Martin Fracker
+// CSCE 463-500 Spring 2017
+#include <gtest/gtest.h>
+#include "LoopbackIo.h"
+#include <chrono>
+#include <set>
+#include <thread>
+
+// Loss recovery against LoopbackIo. Every ack takes a millisecond, so the RTO sits near
+// its 40 ms floor, the tail-loss probe at its 10 ms floor, and a RACK deadline passes
+// about a millisecond after a packet sent later is acked.
+static const UINT64 WARM_UP = 4;
+
+class SenderSocketTest : public ::testing::Test
+{
+protected:
+  BasicSenderSocket<LoopbackSenderPolicies> Sender;
+  char Payload[MAX_PKT_SIZE - sizeof(SenderDataHeader)] = {};
+
+  void Open(DWORD window)
+  {
+    LinkProperties lp;
+    lp.Rtt = 0.001f;
+    lp.Speed = 1e9f;
+    Sender.GetIo().SetDelay(1000);
+    ASSERT_EQ(STATUS_OK, Sender.Open("loopback", MAGIC_PORT, window, &lp));
+  }
+  void Send(UINT64 packets)
+  {
+    for (UINT64 i = 0; i < packets; ++i)
+      ASSERT_EQ(STATUS_OK, Sender.Send(Payload, sizeof(Payload)));
+  }
+  // The millisecond clock times the handshake at zero, and so the first RTO; a few
+  // acked packets give the estimator real samples before any loss
+  void WarmUp()
+  {
+    Send(WARM_UP);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  }
+  void Close()
+  {
+    float transferTime;
+    EXPECT_EQ(STATUS_OK, Sender.Close(&transferTime));
+  }
+  // the first send of each of these is lost
+  void DropOnce(const std::set<UINT64>& sequences)
+  {
+    Sender.GetIo().SetDropHook([sequences](UINT64 sequence, size_t attempt) { return attempt == 1 && sequences.count(sequence) > 0; });
+  }
+  // gives the ack thread up to a second to resend the packet
+  bool WaitForRetransmission(UINT64 sequence)
+  {
+    for (int i = 0; i < 1000; ++i) {
+      if (Sender.GetIo().GetAttempts(sequence) > 1)
+        return true;
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return false;
+  }
+};
+
+TEST_F(SenderSocketTest, LostTailIsRepairedByTheProbe)
+{
+  Open(16);
+  WarmUp();
+  DropOnce({ WARM_UP + 5 });
+  Send(6);
+  // nothing follows the lost packet, so neither duplicate acks nor RACK can see it
+  ASSERT_TRUE(WaitForRetransmission(WARM_UP + 5));
+  Close();
+  auto stats = Sender.GetLossRecoveryStats();
+  EXPECT_EQ(1u, stats.TailProbes);
+  EXPECT_EQ(0u, stats.Timeouts);
+  EXPECT_EQ(0u, stats.FastRetransmissions);
+}
+
+TEST_F(SenderSocketTest, WindowBlockedStallIsNotProbed)
+{
+  Open(2);
+  WarmUp();
+  DropOnce({ WARM_UP, WARM_UP + 1 });
+  // both fill the window, so the sender is blocked on the next with nothing acked
+  Send(4);
+  Close();
+  auto stats = Sender.GetLossRecoveryStats();
+  EXPECT_EQ(0u, stats.TailProbes);
+  EXPECT_GE(stats.Timeouts, 1u);
+  EXPECT_EQ(2u, Sender.GetIo().GetAttempts(WARM_UP));
+}
+
+TEST_F(SenderSocketTest, RackDeadlineRetransmitsTheBase)
+{
+  Open(16);
+  WarmUp();
+  DropOnce({ WARM_UP });
+  Send(1);
+  // RACK orders packets by send time, which the millisecond clock only
+  // resolves if the next ones go out at least a tick later
+  std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  // they come back as two duplicate acks, one short of fast retransmit
+  Send(2);
+  ASSERT_TRUE(WaitForRetransmission(WARM_UP));
+  Close();
+  auto stats = Sender.GetLossRecoveryStats();
+  EXPECT_EQ(1u, stats.FastRetransmissions);
+  EXPECT_EQ(0u, stats.Timeouts);
+  EXPECT_EQ(0u, stats.TailProbes);
+  EXPECT_EQ(2u, Sender.GetIo().GetAttempts(WARM_UP));
+}
@@ -0,0 +1,115 @@
+﻿// File: StreamSchedulerTest.cpp
+// Martin Fracker
+// CSCE 463-500 Spring 2017
+#include <gtest/gtest.h>
+#include <StreamScheduler.h>
+#include <string>
+#include <vector>
+
+static const DWORD PAYLOAD = 4;
+
+class StreamSchedulerTest : public ::testing::Test
+{
+protected:
+  StreamScheduler Scheduler;
+  std::string A = std::string(40, 'a');
+  std::string B = std::string(40, 'b');
+
+  // the streams of the next `packets` packets, as one character each
+  std::string Order(size_t packets)
+  {
+    std::string order;
+    char payload[PAYLOAD];
+    WORD streamId;
+    DWORD streamSequence;
+    for (size_t i = 0; i < packets && Scheduler.Next(&streamId, &streamSequence, payload, PAYLOAD) > 0; ++i)
+      order += static_cast<char>('0' + streamId);
+    return order;
+  }
+};
+
+TEST_F(StreamSchedulerTest, LowerPriorityValueGoesFirst)
+{
+  ASSERT_TRUE(Scheduler.AddStream(1, 5, 1));
+  ASSERT_TRUE(Scheduler.AddStream(2, 1, 1));
+  ASSERT_TRUE(Scheduler.Enqueue(1, A.data(), 8));
+  ASSERT_TRUE(Scheduler.Enqueue(2, B.data(), 8));
+  EXPECT_EQ("2211", Order(10));
+}
+
+TEST_F(StreamSchedulerTest, UrgentDataPreemptsATurn)
+{
+  ASSERT_TRUE(Scheduler.AddStream(1, 5, 4));
+  ASSERT_TRUE(Scheduler.AddStream(2, 1, 1));
+  ASSERT_TRUE(Scheduler.Enqueue(1, A.data(), 16));
+  EXPECT_EQ("1", Order(1));
+  ASSERT_TRUE(Scheduler.Enqueue(2, B.data(), 4));
+  EXPECT_EQ("2111", Order(10));
+}
+
+TEST_F(StreamSchedulerTest, EqualPrioritySplitsByWeight)
+{
+  ASSERT_TRUE(Scheduler.AddStream(1, 0, 1));
+  ASSERT_TRUE(Scheduler.AddStream(2, 0, 2));
+  ASSERT_TRUE(Scheduler.Enqueue(1, A.data(), 12));
+  ASSERT_TRUE(Scheduler.Enqueue(2, B.data(), 24));
+  EXPECT_EQ("122122122", Order(20));
+}
+
+TEST_F(StreamSchedulerTest, SequencesCountPerStream)
+{
+  ASSERT_TRUE(Scheduler.AddStream(1, 0, 1));
+  ASSERT_TRUE(Scheduler.AddStream(2, 0, 1));
+  ASSERT_TRUE(Scheduler.Enqueue(1, A.data(), 8));
+  ASSERT_TRUE(Scheduler.Enqueue(2, B.data(), 8));
+  char payload[PAYLOAD];
+  WORD streamId;
+  DWORD streamSequence;
+  std::vector<DWORD> sequences[3];
+  while (Scheduler.Next(&streamId, &streamSequence, payload, PAYLOAD) > 0)
+    sequences[streamId].push_back(streamSequence);
+  EXPECT_EQ((std::vector<DWORD>{ 0, 1 }), sequences[1]);
+  EXPECT_EQ((std::vector<DWORD>{ 0, 1 }), sequences[2]);
+}
+
+TEST_F(StreamSchedulerTest, SmallWritesShareAPacket)
+{
+  ASSERT_TRUE(Scheduler.AddStream(1, 0, 1));
+  ASSERT_TRUE(Scheduler.Enqueue(1, "xy", 2));
+  ASSERT_TRUE(Scheduler.Enqueue(1, "zw", 2));
+  char payload[PAYLOAD];
+  WORD streamId;
+  DWORD streamSequence;
+  ASSERT_EQ(4u, Scheduler.Next(&streamId, &streamSequence, payload, PAYLOAD));
+  EXPECT_EQ("xyzw", std::string(payload, 4));
+  EXPECT_TRUE(Scheduler.Empty());
+}
+
+TEST_F(StreamSchedulerTest, EmptyStreamsAreSkipped)
+{
+  ASSERT_TRUE(Scheduler.AddStream(1, 0, 1));
+  ASSERT_TRUE(Scheduler.AddStream(2, 0, 1));
+  ASSERT_TRUE(Scheduler.AddStream(3, 0, 1));
+  ASSERT_TRUE(Scheduler.Enqueue(2, B.data(), 8));
+  EXPECT_EQ("22", Order(10));
+}
+
+TEST_F(StreamSchedulerTest, EmptyEdges)
+{
+  EXPECT_TRUE(Scheduler.Empty());
+  char payload[PAYLOAD];
+  WORD streamId;
+  DWORD streamSequence;
+  EXPECT_EQ(0u, Scheduler.Next(&streamId, &streamSequence, payload, PAYLOAD));
+  EXPECT_FALSE(Scheduler.Enqueue(1, A.data(), 4));
+  ASSERT_TRUE(Scheduler.AddStream(1, 0, 1));
+  EXPECT_FALSE(Scheduler.AddStream(1, 2, 1));
+  ASSERT_TRUE(Scheduler.Enqueue(1, A.data(), 0));
+  EXPECT_TRUE(Scheduler.Empty());
+  EXPECT_EQ(0u, Scheduler.Next(&streamId, &streamSequence, payload, PAYLOAD));
+  ASSERT_TRUE(Scheduler.Enqueue(1, A.data(), 6));
+  EXPECT_FALSE(Scheduler.Empty());
+  EXPECT_EQ(4u, Scheduler.Next(&streamId, &streamSequence, payload, PAYLOAD));
+  EXPECT_EQ(2u, Scheduler.Next(&streamId, &streamSequence, payload, PAYLOAD));
+  EXPECT_TRUE(Scheduler.Empty());
+}
@@ -11,7 +11,7 @@
 
 void printUsage()
 {
-  std::cout << "Usage: ReliableUDP <host> <power> <window> <rtt> <forward loss> <return loss> <bottleneck>\n";
+  std::cout << "Usage: ReliableUDP <host> <power> <window> <rtt> <forward loss> <return loss> <bottleneck> [<core> <spin usec>] [--rio] [--ecn] [--v2]\n";
   std::exit(EXIT_FAILURE);
 }
 
@@ -54,8 +54,18 @@ int main(int argc, char* argv[])
   for (UINT64 i = 0; i < dwordBufSize; i++) // required initialization
     dwordBuf[i] = i;
   printf("done in %lu ms\n", timeGetTime() - time);
-  SenderSocket ss; // instance of your class
+  SenderSocket ss(args.RegisteredIo); // instance of your class
+  ss.SetEcn(args.Ecn);
+  ss.SetV2(args.V2);
   int status;
+  if (args.Core >= 0 || args.SpinMicroseconds > 0)
+  {
+    LowLatencyOptions options;
+    options.Core = args.Core;
+    options.SpinMicroseconds = args.SpinMicroseconds;
+    if (!ss.SetLowLatency(options))
+      mainError("cannot pin the ack thread to core %d\n", args.Core);
+  }
   LinkProperties lp;
   lp.Rtt = args.RTT;
   lp.Speed = BITS_IN_MEGABIT * args.BandwidthBottleneck;
@@ -89,5 +99,11 @@ int main(int argc, char* argv[])
   auto packetsSent = ceil(bytesSent / maxPacketSize);
   auto idealRate = bitsTransferred / packetsSent / static_cast<float>(ss.GetEstRTT()) / BITS_IN_KILOBIT * args.WindowSize;
   mainInfo("estRTT %.3f, ideal rate %.2f Kbps\n", ss.GetEstRTT(), idealRate);
+  if (args.SpinMicroseconds > 0)
+  {
+    auto stats = ss.GetLowLatencyStats();
+    auto selectWait = stats.SelectWakeups ? stats.SelectSeconds / stats.SelectWakeups : 0;
+    mainInfo("spin hits %llu misses %llu (%.3f sec polling), select wakeups %llu (avg wait %.1f us), ack thread CPU %.3f sec\n", stats.SpinHits, stats.SpinMisses, stats.SpinSeconds, stats.SelectWakeups, selectWait * 1e6, stats.AckThreadCpuSeconds);
+  }
   return 0;
 }